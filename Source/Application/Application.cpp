@@ -143,26 +143,104 @@ void Application::showFPS(GLFWwindow *pWindow)
 	if (delta >= 1.0) { // If last cout was more than 1 sec ago
 		double fps = double(nb_frames) / delta;
 		const char* mode = "No Cluste Shading";
+		char modeText[128];
+		modeText[127] = '\0';
 		if (((VulkanRenderer*)renderer)->IsClusteShading())
 		{
 			if (!((VulkanRenderer*)renderer)->IsCpuClusteCull())
 				mode = "Computer Shader";
 			else
 			{
-				if (!((VulkanRenderer*)renderer)->IsISPC())
+				if (((VulkanRenderer*)renderer)->IsSimdCull() && ((VulkanRenderer*)renderer)->GetSimdLevel() != SimdCpu::SimdLevel_None)
 				{
-					mode = "Raw C++";
+					snprintf(modeText, 127, "C++ SIMD %s%s", SimdCpu::GetLevelName(((VulkanRenderer*)renderer)->GetSimdLevel()), ((VulkanRenderer*)renderer)->IsMultiThreadCull() ? " MT" : "");
+					mode = modeText;
 				}
-				else
+				else if (!((VulkanRenderer*)renderer)->IsISPC())
+				{
+					if (((VulkanRenderer*)renderer)->GetCpuCullMethod() == CpuCull_LightMajor)
+						mode = "Raw C++ Light Major";
+					else if (((VulkanRenderer*)renderer)->GetCpuCullMethod() == CpuCull_ZBinning)
+						mode = "Raw C++ Z-Binning";
+					else if (((VulkanRenderer*)renderer)->GetCpuCullMethod() == CpuCull_LightBVH)
+						mode = "Raw C++ Light BVH";
+					else if (((VulkanRenderer*)renderer)->GetCpuCullMethod() == CpuCull_SuperCluste)
+						mode = "Raw C++ Super Cluste";
+					else if (((VulkanRenderer*)renderer)->GetCpuCullMethod() == CpuCull_Amortized)
+					{
+						snprintf(modeText, 127, "Raw C++ Amortized 1/%u%s", ((VulkanRenderer*)renderer)->GetAmortizedSliceGroups(), ((VulkanRenderer*)renderer)->IsMultiThreadCull() ? " MT" : "");
+						mode = modeText;
+					}
+					else if (!((VulkanRenderer*)renderer)->IsMultiThreadCull())
+						mode = "Raw C++";
+					else
+						mode = "Raw C++ MT";
+				}
+				else if (!((VulkanRenderer*)renderer)->IsMultiThreadCull())
 				{
 					mode = "ISPC";
 				}
+				else
+				{
+					/// the slowest task bounds the cull time
+					const std::vector<double>& taskTimes = ((VulkanRenderer*)renderer)->GetIspcTaskTimes();
+					double slowestTask = 0.0;
+					for (int i = 0; i < taskTimes.size(); i++)
+					{
+						if (taskTimes[i] > slowestTask)
+							slowestTask = taskTimes[i];
+					}
+					snprintf(modeText, 127, "ISPC Tasks %d, slowest %.4f(ms)", (int)taskTimes.size(), slowestTask);
+					mode = modeText;
+				}
 			}
 		}
 
 		char title[256];
 		title[255] = '\0';
-		snprintf(title, 255, "[FPS: %3.2f] [ClusteShading: %s] [%s][Cull:%.4f(ms)]", fps, ((VulkanRenderer*)renderer)->IsClusteShading() ? "ON" : "OFF", mode, ((VulkanRenderer*)renderer)->GetCpuCullTime());
+		glm::uvec3 grid = ((VulkanRenderer*)renderer)->GetClusteGrid();
+		const char* listFormat = "Indexes";
+		if (((VulkanRenderer*)renderer)->GetClusteListFormat() == ClusteList_Bitmask)
+			listFormat = "Bitmask";
+		else if (((VulkanRenderer*)renderer)->GetClusteListFormat() == ClusteList_Compact)
+			listFormat = "Compact";
+		/// deduplicated lists show culled over stored entries
+		char listText[64];
+		listText[63] = '\0';
+		if (((VulkanRenderer*)renderer)->IsDedupLists())
+			snprintf(listText, 63, "%s Dedup %.2fx", listFormat, ((VulkanRenderer*)renderer)->GetListDedupRatio());
+		else
+			snprintf(listText, 63, "%s", listFormat);
+		/// exact culling shows its saving against the last frame culled with the aabb test only
+		char entriesText[64];
+		entriesText[63] = '\0';
+		glm::uint aabbEntries = ((VulkanRenderer*)renderer)->GetAabbListEntries();
+		if (((VulkanRenderer*)renderer)->IsExactCull() && aabbEntries > 0)
+			snprintf(entriesText, 63, "%u Exact %+.1f%%", ((VulkanRenderer*)renderer)->GetLightListEntries(), 100.0 * ((double)((VulkanRenderer*)renderer)->GetExactListEntries() / aabbEntries - 1.0));
+		else
+			snprintf(entriesText, 63, "%u%s", ((VulkanRenderer*)renderer)->GetLightListEntries(), ((VulkanRenderer*)renderer)->IsExactCull() ? " Exact" : "");
+		/// async culling also shows how long the submit waited for it
+		char cullText[64];
+		cullText[63] = '\0';
+		if (((VulkanRenderer*)renderer)->IsAsyncCull())
+			snprintf(cullText, 63, "%.4f(ms) Wait %.4f", ((VulkanRenderer*)renderer)->GetCpuCullTime(), ((VulkanRenderer*)renderer)->GetCullWaitTime());
+		else
+			snprintf(cullText, 63, "%.4f(ms)", ((VulkanRenderer*)renderer)->GetCpuCullTime());
+		/// reuse state of the frame the title is written in
+		const char* reuse = "Off";
+		if (((VulkanRenderer*)renderer)->IsTemporalReuse())
+		{
+			ClusteCullReuse cullReuse = ((VulkanRenderer*)renderer)->GetCullReuse();
+			reuse = cullReuse == CullReuse_Skipped ? "Skipped" : (cullReuse == CullReuse_Partial ? "Partial" : "Full");
+		}
+		/// cpu culling only counts overflows while the debug check is on
+		char overflowText[16];
+		overflowText[15] = '\0';
+		if (((VulkanRenderer*)renderer)->IsCpuClusteCull() && !((VulkanRenderer*)renderer)->IsOverflowCheck())
+			snprintf(overflowText, 15, "Off");
+		else
+			snprintf(overflowText, 15, "%u", ((VulkanRenderer*)renderer)->GetLightListOverflows());
+		snprintf(title, 255, "[FPS: %3.2f] [ClusteShading: %s] [%s][Cull:%s][Reuse:%s][Grid:%ux%ux%u][List:%s][Entries:%s][Overflow:%s][Frames:%u]", fps, ((VulkanRenderer*)renderer)->IsClusteShading() ? "ON" : "OFF", mode, cullText, reuse, grid.x, grid.y, grid.z, listText, entriesText, overflowText, ((VulkanRenderer*)renderer)->GetFramesInFlight());
 		glfwSetWindowTitle(pWindow, title);
 		nb_frames = 0;
 		last_fps_time = currentTime;
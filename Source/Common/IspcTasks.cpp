@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <chrono>
+
+#include "ThreadPool.h"
+#include "IspcTasks.h"
+
+/// signature of the task functions ispc emits
+typedef void (*IspcTaskFunc)(void* data, int threadIndex, int threadCount, int taskIndex, int taskCount,
+	int taskIndex0, int taskIndex1, int taskIndex2, int taskCount0, int taskCount1, int taskCount2);
+
+struct IspcLaunch
+{
+	IspcTaskFunc func;
+	void* data;
+	int count0;
+	int count1;
+	int count2;
+};
+
+/// everything launched through one handle until its sync
+struct IspcTaskGroup
+{
+	std::vector<IspcLaunch> launches;
+	std::vector<char*> allocations;
+};
+
+namespace IspcTasks
+{
+	static ThreadPool* thread_pool = NULL;
+	static std::vector<double> task_times;
+
+	void SetThreadPool(ThreadPool* threadPool)
+	{
+		thread_pool = threadPool;
+	}
+
+	void ResetTaskTimes()
+	{
+		task_times.clear();
+	}
+
+	const std::vector<double>& GetTaskTimes()
+	{
+		return task_times;
+	}
+
+	static void RunLaunch(IspcLaunch& launch)
+	{
+		int taskCount = launch.count0 * launch.count1 * launch.count2;
+		if (task_times.size() < (size_t)taskCount)
+		{
+			task_times.resize(taskCount, 0.0);
+		}
+
+		/// every task index runs once, so it doubles as a thread index no other running task shares
+		auto runTask = [&launch, taskCount](int taskIndex)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			launch.func(launch.data, taskIndex, taskCount, taskIndex, taskCount,
+				taskIndex % launch.count0, (taskIndex / launch.count0) % launch.count1, taskIndex / (launch.count0 * launch.count1),
+				launch.count0, launch.count1, launch.count2);
+			auto end = std::chrono::high_resolution_clock::now();
+			task_times[taskIndex] += (double)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+		};
+
+		if (thread_pool != NULL)
+		{
+			thread_pool->ParallelFor(taskCount, runTask);
+		}
+		else
+		{
+			for (int taskIndex = 0; taskIndex < taskCount; taskIndex++)
+			{
+				runTask(taskIndex);
+			}
+		}
+	}
+};
+
+extern "C"
+{
+	void* ISPCAlloc(void** handlePtr, int64_t size, int32_t alignment)
+	{
+		if (*handlePtr == NULL)
+		{
+			*handlePtr = new IspcTaskGroup();
+		}
+		IspcTaskGroup* group = (IspcTaskGroup*)*handlePtr;
+
+		char* memory = new char[size + alignment];
+		group->allocations.push_back(memory);
+		return (void*)(((uintptr_t)memory + alignment - 1) & ~((uintptr_t)alignment - 1));
+	}
+
+	void ISPCLaunch(void** handlePtr, void* func, void* data, int count0, int count1, int count2)
+	{
+		if (*handlePtr == NULL)
+		{
+			*handlePtr = new IspcTaskGroup();
+		}
+		IspcTaskGroup* group = (IspcTaskGroup*)*handlePtr;
+
+		IspcLaunch launch;
+		launch.func = (IspcTaskFunc)func;
+		launch.data = data;
+		launch.count0 = count0;
+		launch.count1 = count1;
+		launch.count2 = count2;
+		group->launches.push_back(launch);
+	}
+
+	void ISPCSync(void* handle)
+	{
+		IspcTaskGroup* group = (IspcTaskGroup*)handle;
+		for (size_t i = 0; i < group->launches.size(); i++)
+		{
+			IspcTasks::RunLaunch(group->launches[i]);
+		}
+
+		for (size_t i = 0; i < group->allocations.size(); i++)
+		{
+			delete[] group->allocations[i];
+		}
+		delete group;
+	}
+};
@@ -0,0 +1,19 @@
+#ifndef __ISPC_TASKS_H__
+#define __ISPC_TASKS_H__
+
+#include <vector>
+
+class ThreadPool;
+
+/// host side of ispc launch/sync. launches are deferred to the next sync and every
+/// task of a launch is one ParallelFor call on the pool, serial when there is no pool
+namespace IspcTasks
+{
+	void SetThreadPool(ThreadPool* threadPool);
+
+	/// per task index milliseconds summed over every launch since the last reset
+	void ResetTaskTimes();
+	const std::vector<double>& GetTaskTimes();
+};
+
+#endif // !__ISPC_TASKS_H__
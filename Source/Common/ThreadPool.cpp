@@ -0,0 +1,113 @@
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadNum)
+{
+	stopping = false;
+	if (threadNum == 0)
+	{
+		unsigned int hwThreads = std::thread::hardware_concurrency();
+		threadNum = hwThreads > 1 ? hwThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadNum; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasks_mutex);
+		stopping = true;
+	}
+	tasks_cv.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(tasks_mutex);
+			tasks_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+			{
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& func)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	/// shared by the helpers, lives on this stack until every helper has left
+	std::atomic<int> next(0);
+	std::mutex doneMutex;
+	std::condition_variable doneCv;
+	int helperNum = std::min(count - 1, (int)workers.size());
+	int pending = helperNum;
+
+	auto run = [&]()
+	{
+		int i;
+		while ((i = next.fetch_add(1)) < count)
+		{
+			func(i);
+		}
+	};
+
+	if (helperNum > 0)
+	{
+		std::lock_guard<std::mutex> lock(tasks_mutex);
+		for (int i = 0; i < helperNum; i++)
+		{
+			tasks.push_back([&]()
+			{
+				run();
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (--pending == 0)
+				{
+					doneCv.notify_one();
+				}
+			});
+		}
+	}
+	tasks_cv.notify_all();
+
+	run();
+
+	std::unique_lock<std::mutex> doneLock(doneMutex);
+	doneCv.wait(doneLock, [&] { return pending == 0; });
+}
+
+std::future<void> ThreadPool::Submit(const std::function<void()>& task)
+{
+	/// std::function needs a copyable callable, the packaged task is shared
+	std::shared_ptr<std::packaged_task<void()>> packagedTask = std::make_shared<std::packaged_task<void()>>(task);
+	std::future<void> future = packagedTask->get_future();
+	{
+		std::lock_guard<std::mutex> lock(tasks_mutex);
+		tasks.push_back([packagedTask]() { (*packagedTask)(); });
+	}
+	tasks_cv.notify_one();
+	return future;
+}
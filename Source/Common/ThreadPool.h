@@ -0,0 +1,40 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+/// persistent worker threads, the calling thread always takes part in ParallelFor
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threadNum = 0);	/// 0: one worker per hardware thread except the caller
+	virtual ~ThreadPool();
+
+	/// number of threads working on a ParallelFor, caller included
+	unsigned int GetConcurrency() { return (unsigned int)workers.size() + 1; }
+
+	/// call func(0..count-1) across the pool and return when all calls are done
+	void ParallelFor(int count, const std::function<void(int)>& func);
+
+	/// run task on a worker and return at once, the future rethrows what the task threw.
+	/// a task must not call ParallelFor on its own pool, it would wait on helpers queued behind itself
+	std::future<void> Submit(const std::function<void()>& task);
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex tasks_mutex;
+	std::condition_variable tasks_cv;
+	bool stopping;
+};
+
+#endif // !__THREAD_POOL_H__
@@ -10,6 +10,8 @@
 Camera::Camera(float s_width, float s_height)
 	:screen_width(s_width)
 	,screen_height(s_height)
+	,project_version(0)
+	,view_version(0)
 {
 	glm::vec3 p = glm::vec3(1027,183,46);
 	SetPosition(p);
@@ -53,7 +55,13 @@ glm::mat4x4* Camera::UpdateMatrix()
 {
 	if (transform_changed)
 	{
-		matrix = glm::lookAt(position, look_at, glm::vec3(0, 1, 0));	/// vulkan is right-hand and y is downward
+		/// the input code sets the position every frame, only a different matrix counts as a change
+		glm::mat4x4 viewMtx = glm::lookAt(position, look_at, glm::vec3(0, 1, 0));	/// vulkan is right-hand and y is downward
+		if (viewMtx != matrix)
+		{
+			matrix = viewMtx;
+			view_version++;
+		}
 		transform_changed = false;
 	}
 	return &matrix;
@@ -77,6 +85,7 @@ glm::mat4x4* Camera::UpdateProjectMatrix()
 	{
 		project_mat = glm::perspective(glm::radians(fov), screen_width/screen_height, near_clamp, far_clamp); /// vulkan is right-hand
 		project_changed = false;
+		project_version++;
 	}
 	return &project_mat;
 }
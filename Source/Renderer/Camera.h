@@ -24,6 +24,11 @@ public:
 	glm::mat4x4* GetProjectMatrix() { return &project_mat; }
 	glm::mat4x4* GetViewProjectMatrix() { return &view_project_mtx; }
 
+	/// bumped every time the projection matrix is rebuilt
+	unsigned int GetProjectVersion() { return project_version; }
+	/// bumped every time the view matrix changes
+	unsigned int GetViewVersion() { return view_version; }
+
 	glm::vec3 GetLookAtPosition() { return look_at; }
 
 	void UpdateLookAt();
@@ -49,6 +54,8 @@ private:
 	float screen_height;
 
 	bool project_changed;
+	unsigned int project_version;
+	unsigned int view_version;
 	glm::mat4x4 project_mat;
 
 	glm::mat4x4 view_project_mtx;
@@ -1,6 +1,18 @@
 #ifndef __CLUSTE_CULLING_H__
 #define	__CLUSTE_CULLING_H__
 
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "Common/ThreadPool.h"
+#include "LightBVH.h"
+#include "ClusteCullingSimd.h"
+
 namespace RawCpu
 {
 	static glm::vec3 lineIntersectionToZPlane(glm::vec3& A, glm::vec3& B, float zDistance) {
@@ -57,69 +69,166 @@ namespace RawCpu
 		return sqDist;
 	}
 
-	static bool testSphereAABB(ScreenToView& screenToView, glm::vec3& pos, float radius, glm::vec3& minPoint, glm::vec3& maxPoint)
+	/// viewLight: view space center in xyz, radius in w
+	static bool testSphereAABB(glm::vec4& viewLight, glm::vec3& minPoint, glm::vec3& maxPoint)
 	{
-		glm::vec3 center = glm::vec3(screenToView.viewMatrix*glm::vec4(pos, 1.0f));
+		glm::vec3 center = glm::vec3(viewLight);
+		float radius = viewLight.w;
 		float squaredDistance = sqDistPointAABB(center, minPoint, maxPoint);
 
 		bool ret = (squaredDistance <= (radius * radius));
 		return ret;
 	}
 
-	static void cluste_culling(int xSize, int ySize, int zSize, ScreenToView& screenToView, PointLightData* pointLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	/// tilePlanes: the 4 side planes of a screen tile from build_tile_planes. the aabb of a far cluste
+	/// is much wider than the cluste, the planes drop lights that only touch the difference
+	static bool testSpherePlanes(glm::vec4& viewLight, const glm::vec4* tilePlanes)
 	{
-		int globalIndexCount = 0;
+		glm::vec3 center = glm::vec3(viewLight);
+		for (int i = 0; i < 4; i++)
+		{
+			if (glm::dot(glm::vec3(tilePlanes[i]), center) + tilePlanes[i].w < -viewLight.w)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// exact culling when tilePlanes is not NULL, the aabb still bounds the depth range
+	static bool testSphereCluste(glm::vec4& viewLight, glm::vec3& minPoint, glm::vec3& maxPoint, const glm::vec4* tilePlanes)
+	{
+		return testSphereAABB(viewLight, minPoint, maxPoint) && (tilePlanes == NULL || testSpherePlanes(viewLight, tilePlanes));
+	}
+
+	/// planes of the screen tile a cluste lies in, NULL when tilePlanes is NULL
+	static const glm::vec4* cluste_tile_planes(const glm::vec4* tilePlanes, glm::uint tileIndex, int xSize, int ySize)
+	{
+		return tilePlanes != NULL ? tilePlanes + (tileIndex % (xSize * ySize)) * 4 : NULL;
+	}
+
+	/// light transform stage, run once per frame before culling:
+	/// view space center + radius per light, disabled lights get a negative radius
+	/// inputs are the structure-of-arrays lanes of LightStore
+	static void transform_lights(ScreenToView& screenToView, int lightCount, float* posX, float* posY, float* posZ, float* radius, glm::uint* enabledBits, glm::vec4* viewLights)
+	{
+		for (int light = 0; light < lightCount; light++)
+		{
+			glm::vec3 center = glm::vec3(screenToView.viewMatrix * glm::vec4(posX[light], posY[light], posZ[light], 1.0f));
+			bool enabled = ((enabledBits[light >> 5] >> (light & 31)) & 1) != 0;
+			viewLights[light] = glm::vec4(center, enabled ? radius[light] : -1.0f);
+		}
+	}
+
+	/// view space depth of the zSize + 1 slice boundaries, one pow per boundary instead of two per cluste.
+	/// zNear and zFar are runtime values, the boundaries are computed whenever the aabbs are rebuilt,
+	/// which UpdateClusteAABBs only does for a new projection, screen size or grid
+	static void slice_depths(int zSize, float zNear, float zFar, float* depths)
+	{
+		for (int z = 0; z <= zSize; z++)
+		{
+			depths[z] = -zNear * pow(zFar / zNear, (float)z / zSize);
+		}
+	}
 
+	static void cluste_aabb(int x, int y, float tileNear, float tileFar, ScreenToView& screenToView, glm::vec3& minPointAABB, glm::vec3& maxPointAABB)
+	{
 		//Eye position is zero in view space
 		glm::vec3 eyePos = glm::vec3(0.0);
-		float zNear = screenToView.zNear;
-		float zFar = screenToView.zFar;
 
 		//Per Tile variables
 		float tileSizePx = screenToView.tileSizes[3];
-		for (int x = 0; x < xSize; x++)
+
+		//Calculating the min and max point in screen space
+		glm::vec4 maxPoint_sS = glm::vec4(glm::vec2(x + 1, y + 1) * tileSizePx, -1.0, 1.0); // Top Right
+		glm::vec4 minPoint_sS = glm::vec4(glm::vec2(x, y) * tileSizePx, -1.0, 1.0); // Bottom left
+
+		//Pass min and max to view space
+		glm::vec3 maxPoint_vS = glm::vec3(screen2View(maxPoint_sS, screenToView));
+		glm::vec3 minPoint_vS = glm::vec3(screen2View(minPoint_sS, screenToView));
+
+		//Finding the 4 intersection points made from the maxPoint to the cluster near/far plane
+		glm::vec3 minPointNear = lineIntersectionToZPlane(eyePos, minPoint_vS, tileNear);
+		glm::vec3 minPointFar = lineIntersectionToZPlane(eyePos, minPoint_vS, tileFar);
+		glm::vec3 maxPointNear = lineIntersectionToZPlane(eyePos, maxPoint_vS, tileNear);
+		glm::vec3 maxPointFar = lineIntersectionToZPlane(eyePos, maxPoint_vS, tileFar);
+
+		minPointAABB = min(min(minPointNear, minPointFar), min(maxPointNear, maxPointFar));
+		maxPointAABB = max(max(minPointNear, minPointFar), max(maxPointNear, maxPointFar));
+	}
+
+	/// the aabbs only depend on projection, resolution and grid size, so they are built once and cached by the caller.
+	/// a template size of 0 takes the runtime size
+	template<int XSize, int YSize, int ZSize>
+	static void build_cluste_aabbs_grid(int xSize, int ySize, int zSize, ScreenToView& screenToView, VolumeTileAABB* clusteAABBs)
+	{
+		if (XSize > 0) xSize = XSize;
+		if (YSize > 0) ySize = YSize;
+		if (ZSize > 0) zSize = ZSize;
+
+		std::vector<float> depths(zSize + 1);
+		slice_depths(zSize, screenToView.zNear, screenToView.zFar, depths.data());
+
+		for (int z = 0; z < zSize; z++)
 		{
 			for (int y = 0; y < ySize; y++)
 			{
-				for (int z = 0; z < zSize; z++)
+				for (int x = 0; x < xSize; x++)
 				{
 					glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
 
-					//Calculating the min and max point in screen space
-					glm::vec4 maxPoint_sS = glm::vec4(glm::vec2(x + 1, y + 1) * tileSizePx, -1.0, 1.0); // Top Right
-					glm::vec4 minPoint_sS = glm::vec4(glm::vec2(x, y) * tileSizePx, -1.0, 1.0); // Bottom left
+					glm::vec3 minPointAABB, maxPointAABB;
+					cluste_aabb(x, y, depths[z], depths[z + 1], screenToView, minPointAABB, maxPointAABB);
+					clusteAABBs[tileIndex].minPoint = glm::vec4(minPointAABB, 0.0f);
+					clusteAABBs[tileIndex].maxPoint = glm::vec4(maxPointAABB, 0.0f);
+				}
+			}
+		}
+	}
+
+	/// keeps the first MAX_LIGHTS_PER_CLUSTE hits in light order
+	static glm::uint cluste_lights(glm::vec4* viewLights, int lightCount, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, const glm::vec4* tilePlanes, glm::uint* visibleLightIndices)
+	{
+		glm::uint visibleLightCount = 0;
+
+		for (int light = 0; light < lightCount && visibleLightCount < MAX_LIGHTS_PER_CLUSTE; light++)
+		{
+			if (viewLights[light].w >= 0.0f)
+			{
+				if (testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, tilePlanes))
+				{
+					visibleLightIndices[visibleLightCount] = light;
+					visibleLightCount += 1;
+				}
+			}
+		}
 
-					//Pass min and max to view space
-					glm::vec3 maxPoint_vS = glm::vec3(screen2View(maxPoint_sS, screenToView));
-					glm::vec3 minPoint_vS = glm::vec3(screen2View(minPoint_sS, screenToView));
+		return visibleLightCount;
+	}
 
-					//Near and far values of the cluster in view space
-					float tileNear = -zNear * pow(zFar / zNear, (float)z / zSize);
-					float tileFar = -zNear * pow(zFar / zNear, (float)(z + 1) / zSize);
+	/// a template size of 0 takes the runtime size, fixed sizes let the compiler unroll the grid loops
+	template<int XSize, int YSize, int ZSize>
+	static void cluste_culling_grid(int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		if (XSize > 0) xSize = XSize;
+		if (YSize > 0) ySize = YSize;
+		if (ZSize > 0) zSize = ZSize;
 
-					//Finding the 4 intersection points made from the maxPoint to the cluster near/far plane
-					glm::vec3 minPointNear = lineIntersectionToZPlane(eyePos, minPoint_vS, tileNear);
-					glm::vec3 minPointFar = lineIntersectionToZPlane(eyePos, minPoint_vS, tileFar);
-					glm::vec3 maxPointNear = lineIntersectionToZPlane(eyePos, maxPoint_vS, tileNear);
-					glm::vec3 maxPointFar = lineIntersectionToZPlane(eyePos, maxPoint_vS, tileFar);
+		int globalIndexCount = 0;
 
-					glm::vec3 minPointAABB = min(min(minPointNear, minPointFar), min(maxPointNear, maxPointFar));
-					glm::vec3 maxPointAABB = max(max(minPointNear, minPointFar), max(maxPointNear, maxPointFar));
+		for (int x = 0; x < xSize; x++)
+		{
+			for (int y = 0; y < ySize; y++)
+			{
+				for (int z = 0; z < zSize; z++)
+				{
+					glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
 
-					glm::uint visibleLightIndices[100];
-					glm::uint visibleLightCount = 0;
+					glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+					glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
 
-					for (int light = 0; light < lightCount; light++)
-					{
-						if (pointLights[light].enabled == 1)
-						{
-							if (testSphereAABB(screenToView, pointLights[light].pos, pointLights[light].radius, minPointAABB, maxPointAABB))
-							{
-								visibleLightIndices[visibleLightCount] = light;
-								visibleLightCount += 1;
-							}
-						}
-					}
+					glm::uint visibleLightIndices[MAX_LIGHTS_PER_CLUSTE];
+					glm::uint visibleLightCount = cluste_lights(viewLights, lightCount, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), visibleLightIndices);
 
 					///glm::uint offset = atomic_add_global(&globalIndexCount, visibleLightCount);
 					glm::uint offset = globalIndexCount;
@@ -136,6 +245,815 @@ namespace RawCpu
 			}
 		}
 	}
+
+	/// grids the defaults and the tuner commonly end up with get a specialized kernel,
+	/// any other shape runs the generic one. only the grid loops get constant bounds,
+	/// the light loop still runs over the runtime light count
+#define CLUSTE_GRID_SPECIALIZATIONS(GRID) \
+	GRID(16, 9, 16) \
+	GRID(16, 9, 24) \
+	GRID(16, 9, 32) \
+	GRID(20, 12, 24) \
+	GRID(32, 18, 24)
+
+	static void build_cluste_aabbs(int xSize, int ySize, int zSize, ScreenToView& screenToView, VolumeTileAABB* clusteAABBs)
+	{
+#define BUILD_AABBS_GRID(X, Y, Z) \
+		if (xSize == X && ySize == Y && zSize == Z) { build_cluste_aabbs_grid<X, Y, Z>(xSize, ySize, zSize, screenToView, clusteAABBs); return; }
+		CLUSTE_GRID_SPECIALIZATIONS(BUILD_AABBS_GRID)
+#undef BUILD_AABBS_GRID
+		build_cluste_aabbs_grid<0, 0, 0>(xSize, ySize, zSize, screenToView, clusteAABBs);
+	}
+
+	/// tilePlanes: 4 planes per screen tile for the exact test, NULL for the aabb test only
+	static void cluste_culling(int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+#define CULLING_GRID(X, Y, Z) \
+		if (xSize == X && ySize == Y && zSize == Z) { cluste_culling_grid<X, Y, Z>(xSize, ySize, zSize, clusteAABBs, tilePlanes, viewLights, lightCount, lightGrids, globalLightIndexList); return; }
+		CLUSTE_GRID_SPECIALIZATIONS(CULLING_GRID)
+#undef CULLING_GRID
+		cluste_culling_grid<0, 0, 0>(xSize, ySize, zSize, clusteAABBs, tilePlanes, viewLights, lightCount, lightGrids, globalLightIndexList);
+	}
+#undef CLUSTE_GRID_SPECIALIZATIONS
+
+	/// every job owns a contiguous run of the serial (x, y, z) visit order and fills a private index list,
+	/// the lists are then placed with a prefix sum over the jobs so offsets follow the serial order.
+	/// lister(job, tileIndex, minPoint, maxPoint, visibleLightIndices) returns the light count of one cluste.
+	/// threadPool may be NULL for a serial run
+	template<typename ClusteLister>
+	static void cluste_culling_jobs(ThreadPool* threadPool, int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, ClusteLister& lister, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		int jobNum = threadPool != NULL ? std::min((int)threadPool->GetConcurrency(), clusteNum) : 1;
+		int clustesPerJob = (clusteNum + jobNum - 1) / jobNum;
+
+		std::vector<std::vector<glm::uint>> jobIndices(jobNum);
+		std::vector<glm::uint> jobOffsets(jobNum);
+		auto runJobs = [&](const std::function<void(int)>& func)
+		{
+			if (threadPool != NULL)
+				threadPool->ParallelFor(jobNum, func);
+			else
+				func(0);
+		};
+
+		/// pass 1: cull, offsets are local to the job
+		runJobs([&](int job)
+		{
+			std::vector<glm::uint>& indices = jobIndices[job];
+			int visitEnd = std::min((job + 1) * clustesPerJob, clusteNum);
+			for (int visit = job * clustesPerJob; visit < visitEnd; visit++)
+			{
+				int x = visit / (ySize * zSize);
+				int y = (visit / zSize) % ySize;
+				int z = visit % zSize;
+				glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
+
+				glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+				glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+
+				glm::uint visibleLightIndices[MAX_LIGHTS_PER_CLUSTE];
+				glm::uint visibleLightCount = lister(job, tileIndex, minPointAABB, maxPointAABB, visibleLightIndices);
+
+				lightGrids[tileIndex].offset = (glm::uint)indices.size();
+				lightGrids[tileIndex].count = visibleLightCount;
+				indices.insert(indices.end(), visibleLightIndices, visibleLightIndices + visibleLightCount);
+			}
+		});
+
+		/// pass 2: exclusive prefix sum of the job totals
+		glm::uint globalIndexCount = 0;
+		for (int job = 0; job < jobNum; job++)
+		{
+			jobOffsets[job] = globalIndexCount;
+			globalIndexCount += (glm::uint)jobIndices[job].size();
+		}
+
+		/// pass 3: place the job lists and rebase their grids
+		runJobs([&](int job)
+		{
+			std::vector<glm::uint>& indices = jobIndices[job];
+			if (!indices.empty())
+			{
+				memcpy(globalLightIndexList + jobOffsets[job], indices.data(), indices.size() * sizeof(glm::uint));
+			}
+
+			int visitEnd = std::min((job + 1) * clustesPerJob, clusteNum);
+			for (int visit = job * clustesPerJob; visit < visitEnd; visit++)
+			{
+				int x = visit / (ySize * zSize);
+				int y = (visit / zSize) % ySize;
+				int z = visit % zSize;
+				lightGrids[x + y * xSize + z * xSize * ySize].offset += jobOffsets[job];
+			}
+		});
+	}
+
+	/// same output as cluste_culling byte for byte
+	static void cluste_culling_parallel(ThreadPool* threadPool, int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		auto lister = [&](int job, glm::uint tileIndex, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, glm::uint* visibleLightIndices)
+		{
+			return cluste_lights(viewLights, lightCount, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), visibleLightIndices);
+		};
+		cluste_culling_jobs(threadPool, xSize, ySize, zSize, clusteAABBs, lister, lightGrids, globalLightIndexList);
+	}
+
+	/// bvh culling: every cluste queries the light bvh instead of scanning all lights. the candidates are
+	/// sorted before the exact test, so the lists, clamp included, match cluste_culling's
+	static void cluste_culling_bvh(ThreadPool* threadPool, int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, LightBVH& lightBVH, glm::vec4* viewLights, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		int jobNum = threadPool != NULL ? (int)threadPool->GetConcurrency() : 1;
+		std::vector<std::vector<glm::uint>> jobCandidates(jobNum);
+		auto lister = [&](int job, glm::uint tileIndex, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, glm::uint* visibleLightIndices)
+		{
+			std::vector<glm::uint>& candidates = jobCandidates[job];
+			candidates.clear();
+			lightBVH.Query(minPointAABB, maxPointAABB, candidates);
+			std::sort(candidates.begin(), candidates.end());
+
+			const glm::vec4* planes = cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize);
+			glm::uint visibleLightCount = 0;
+			for (size_t i = 0; i < candidates.size() && visibleLightCount < MAX_LIGHTS_PER_CLUSTE; i++)
+			{
+				if (testSphereCluste(viewLights[candidates[i]], minPointAABB, maxPointAABB, planes))
+				{
+					visibleLightIndices[visibleLightCount] = candidates[i];
+					visibleLightCount += 1;
+				}
+			}
+			return visibleLightCount;
+		};
+		cluste_culling_jobs(threadPool, xSize, ySize, zSize, clusteAABBs, lister, lightGrids, globalLightIndexList);
+	}
+
+	/// two level culling: lights are first tested against super clustes of superSize clustes,
+	/// each cluste then only tests the lights of its super cluste. a super cluste aabb holds its
+	/// children, so the lists, clamp included, match cluste_culling's
+	static void cluste_culling_super(ThreadPool* threadPool, int xSize, int ySize, int zSize, glm::ivec3 superSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		glm::ivec3 superNum = (glm::ivec3(xSize, ySize, zSize) + superSize - 1) / superSize;
+		int superTotal = superNum.x * superNum.y * superNum.z;
+		auto superIndexOf = [&](int x, int y, int z)
+		{
+			return x / superSize.x + (y / superSize.y) * superNum.x + (z / superSize.z) * superNum.x * superNum.y;
+		};
+
+		/// super cluste bounds from the cached child aabbs
+		std::vector<glm::vec3> superMin(superTotal, glm::vec3(FLT_MAX));
+		std::vector<glm::vec3> superMax(superTotal, glm::vec3(-FLT_MAX));
+		for (int z = 0; z < zSize; z++)
+		{
+			for (int y = 0; y < ySize; y++)
+			{
+				for (int x = 0; x < xSize; x++)
+				{
+					VolumeTileAABB& aabb = clusteAABBs[x + y * xSize + z * xSize * ySize];
+					int superIndex = superIndexOf(x, y, z);
+					superMin[superIndex] = glm::min(superMin[superIndex], glm::vec3(aabb.minPoint));
+					superMax[superIndex] = glm::max(superMax[superIndex], glm::vec3(aabb.maxPoint));
+				}
+			}
+		}
+
+		/// coarse pass, candidates stay in light order
+		std::vector<std::vector<glm::uint>> superLights(superTotal);
+		auto coarse = [&](int superIndex)
+		{
+			std::vector<glm::uint>& candidates = superLights[superIndex];
+			for (int light = 0; light < lightCount; light++)
+			{
+				if (viewLights[light].w >= 0.0f && testSphereAABB(viewLights[light], superMin[superIndex], superMax[superIndex]))
+				{
+					candidates.push_back(light);
+				}
+			}
+		};
+		if (threadPool != NULL)
+			threadPool->ParallelFor(superTotal, coarse);
+		else
+			for (int superIndex = 0; superIndex < superTotal; superIndex++)
+				coarse(superIndex);
+
+		/// fine pass
+		auto lister = [&](int job, glm::uint tileIndex, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, glm::uint* visibleLightIndices)
+		{
+			int x = tileIndex % xSize;
+			int y = (tileIndex / xSize) % ySize;
+			int z = tileIndex / (xSize * ySize);
+			std::vector<glm::uint>& candidates = superLights[superIndexOf(x, y, z)];
+
+			const glm::vec4* planes = cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize);
+			glm::uint visibleLightCount = 0;
+			for (size_t i = 0; i < candidates.size() && visibleLightCount < MAX_LIGHTS_PER_CLUSTE; i++)
+			{
+				if (testSphereCluste(viewLights[candidates[i]], minPointAABB, maxPointAABB, planes))
+				{
+					visibleLightIndices[visibleLightCount] = candidates[i];
+					visibleLightCount += 1;
+				}
+			}
+			return visibleLightCount;
+		};
+		cluste_culling_jobs(threadPool, xSize, ySize, zSize, clusteAABBs, lister, lightGrids, globalLightIndexList);
+	}
+
+	/// intrinsics culling, clusteLights is one of the SimdCpu kernels. same output as cluste_culling
+	static void cluste_culling_simd(ThreadPool* threadPool, int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, const SimdCpu::SoaLights& lights, SimdCpu::ClusteLightsFunc clusteLights, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		auto lister = [&](int job, glm::uint tileIndex, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, glm::uint* visibleLightIndices)
+		{
+			return clusteLights(lights, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), MAX_LIGHTS_PER_CLUSTE, visibleLightIndices);
+		};
+		cluste_culling_jobs(threadPool, xSize, ySize, zSize, clusteAABBs, lister, lightGrids, globalLightIndexList);
+	}
+
+	/// bitmask output: maskWords words per cluste, bit i set when light i touches the cluste.
+	/// no offsets and no clamp, every cluste owns its words so the clustes are culled independently
+	static void cluste_lights_bitmask(glm::vec4* viewLights, int lightCount, glm::vec3& minPointAABB, glm::vec3& maxPointAABB, const glm::vec4* tilePlanes, int maskWords, glm::uint* lightMask)
+	{
+		memset(lightMask, 0, sizeof(glm::uint) * maskWords);
+		for (int light = 0; light < lightCount; light++)
+		{
+			if (viewLights[light].w >= 0.0f && testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, tilePlanes))
+			{
+				lightMask[light >> 5] |= 1u << (light & 31);
+			}
+		}
+	}
+
+	/// threadPool may be NULL for a serial run
+	static void cluste_culling_bitmask(ThreadPool* threadPool, int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, int maskWords, glm::uint* lightMasks)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		int jobNum = threadPool != NULL ? std::min((int)threadPool->GetConcurrency(), clusteNum) : 1;
+		int clustesPerJob = (clusteNum + jobNum - 1) / jobNum;
+
+		auto cull = [&](int job)
+		{
+			int tileEnd = std::min((job + 1) * clustesPerJob, clusteNum);
+			for (int tileIndex = job * clustesPerJob; tileIndex < tileEnd; tileIndex++)
+			{
+				glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+				glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+				cluste_lights_bitmask(viewLights, lightCount, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), maskWords, lightMasks + tileIndex * maskWords);
+			}
+		};
+
+		if (threadPool != NULL)
+			threadPool->ParallelFor(jobNum, cull);
+		else
+			cull(0);
+	}
+
+	/// light-major culling: instead of testing every light in every cluster, each light only visits
+	/// the z-slices its depth range projects to and, inside each slice, the rectangle of columns/rows
+	/// whose extent overlaps the sphere. testSphereCluste still decides, so the lists are the same
+	/// as cluste_culling's, offsets are laid out in the same (x, y, z) visit order
+	static void cluste_culling_light_major(int xSize, int ySize, int zSize, ScreenToView& screenToView, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		float zNear = screenToView.zNear;
+		float zFar = screenToView.zFar;
+		float sliceScale = (float)zSize / std::log(zFar / zNear);
+
+		/// extent of every column / row in each slice
+		std::vector<glm::vec2> columnExtents(xSize * zSize, glm::vec2(FLT_MAX, -FLT_MAX));
+		std::vector<glm::vec2> rowExtents(ySize * zSize, glm::vec2(FLT_MAX, -FLT_MAX));
+		for (int z = 0; z < zSize; z++)
+		{
+			for (int y = 0; y < ySize; y++)
+			{
+				for (int x = 0; x < xSize; x++)
+				{
+					VolumeTileAABB& aabb = clusteAABBs[x + y * xSize + z * xSize * ySize];
+
+					glm::vec2& column = columnExtents[x + z * xSize];
+					column.x = std::min(column.x, aabb.minPoint.x);
+					column.y = std::max(column.y, aabb.maxPoint.x);
+					glm::vec2& row = rowExtents[y + z * ySize];
+					row.x = std::min(row.x, aabb.minPoint.y);
+					row.y = std::max(row.y, aabb.maxPoint.y);
+				}
+			}
+		}
+
+		/// pass 1: every light marks the clusters it touches, lights are visited in index order
+		/// so each cluster's hits come out sorted like in the cluster-major loop
+		std::vector<glm::uint> counts(clusteNum, 0);
+		std::vector<glm::uvec2> hits;	/// (tile, light)
+		for (int light = 0; light < lightCount; light++)
+		{
+			float radius = viewLights[light].w;
+			if (radius < 0.0f)
+			{
+				continue;
+			}
+			glm::vec3 center = glm::vec3(viewLights[light]);
+
+			/// view looks down -z, slices grow exponentially from zNear to zFar
+			float depthNear = -center.z - radius;
+			float depthFar = -center.z + radius;
+			if (depthFar < zNear || depthNear > zFar)
+			{
+				continue;
+			}
+			int zFirst = depthNear <= zNear ? 0 : (int)(std::log(depthNear / zNear) * sliceScale) - 1;
+			int zLast = (int)(std::log(depthFar / zNear) * sliceScale) + 1;
+			zFirst = std::max(zFirst, 0);
+			zLast = std::min(zLast, zSize - 1);
+
+			for (int z = zFirst; z <= zLast; z++)
+			{
+				/// screen space rectangle of the sphere inside this slice
+				int xFirst = 0, xLast = xSize - 1;
+				while (xFirst <= xLast && columnExtents[xFirst + z * xSize].y < center.x - radius) xFirst++;
+				while (xLast >= xFirst && columnExtents[xLast + z * xSize].x > center.x + radius) xLast--;
+				int yFirst = 0, yLast = ySize - 1;
+				while (yFirst <= yLast && rowExtents[yFirst + z * ySize].y < center.y - radius) yFirst++;
+				while (yLast >= yFirst && rowExtents[yLast + z * ySize].x > center.y + radius) yLast--;
+
+				for (int y = yFirst; y <= yLast; y++)
+				{
+					for (int x = xFirst; x <= xLast; x++)
+					{
+						glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
+						glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+						glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+						if (counts[tileIndex] < MAX_LIGHTS_PER_CLUSTE && testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize)))
+						{
+							counts[tileIndex] += 1;
+							hits.push_back(glm::uvec2(tileIndex, light));
+						}
+					}
+				}
+			}
+		}
+
+		/// pass 2: offsets in the serial visit order
+		glm::uint globalIndexCount = 0;
+		for (int x = 0; x < xSize; x++)
+		{
+			for (int y = 0; y < ySize; y++)
+			{
+				for (int z = 0; z < zSize; z++)
+				{
+					glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
+					lightGrids[tileIndex].offset = globalIndexCount;
+					lightGrids[tileIndex].count = counts[tileIndex];
+					globalIndexCount += counts[tileIndex];
+				}
+			}
+		}
+
+		/// pass 3: scatter, counts is reused as the per cluster write cursor
+		std::fill(counts.begin(), counts.end(), 0);
+		for (size_t i = 0; i < hits.size(); i++)
+		{
+			glm::uint tileIndex = hits[i].x;
+			globalLightIndexList[lightGrids[tileIndex].offset + counts[tileIndex]] = hits[i].y;
+			counts[tileIndex] += 1;
+		}
+	}
+
+	/// total light list entries, what the fragment shader loops over
+	static glm::uint count_list_entries(int clusteNum, LightGrid* lightGrids)
+	{
+		glm::uint entries = 0;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			entries += lightGrids[tileIndex].count;
+		}
+		return entries;
+	}
+
+	/// entries up to the end of the last list, what a copy of the index list has to cover
+	static glm::uint count_list_extent(int clusteNum, LightGrid* lightGrids)
+	{
+		glm::uint extent = 0;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			if (lightGrids[tileIndex].count > 0)
+			{
+				extent = std::max(extent, lightGrids[tileIndex].offset + lightGrids[tileIndex].count);
+			}
+		}
+		return extent;
+	}
+
+	static glm::uint count_mask_entries(int clusteNum, int maskWords, glm::uint* lightMasks)
+	{
+		glm::uint entries = 0;
+		for (int word = 0; word < clusteNum * maskWords; word++)
+		{
+			for (glm::uint bits = lightMasks[word]; bits != 0; bits &= bits - 1)
+			{
+				entries += 1;
+			}
+		}
+		return entries;
+	}
+
+	/// clustes whose list was clamped: every backend keeps the first MAX_LIGHTS_PER_CLUSTE hits in light order,
+	/// so a full list overflowed when a light after its last entry still touches the cluste
+	static glm::uint count_list_overflows(int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		glm::uint overflows = 0;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			LightGrid& lightGrid = lightGrids[tileIndex];
+			if (lightGrid.count < MAX_LIGHTS_PER_CLUSTE)
+			{
+				continue;
+			}
+
+			glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+			glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+			const glm::vec4* planes = cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize);
+			for (int light = globalLightIndexList[lightGrid.offset + lightGrid.count - 1] + 1; light < lightCount; light++)
+			{
+				if (viewLights[light].w >= 0.0f && testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, planes))
+				{
+					overflows++;
+					break;
+				}
+			}
+		}
+		return overflows;
+	}
+
+	static_assert(MAX_LIGHTS_PER_CLUSTE < (1 << LIGHT_GRID_COUNT_BITS), "cluste light count does not fit the compact light grid");
+
+	/// compact lists: 16 bit light indexes and one word per light grid, offset << LIGHT_GRID_COUNT_BITS | count.
+	/// the lists are packed in tile order, whatever layout the index lists had. sharedEntries > 0 takes the lists
+	/// as the dense output of dedup_light_lists, whose grids share runs, so the offsets are kept.
+	/// the caller only picks compact lists when every offset fits COMPACT_LIST_MAX_ENTRIES
+	static void pack_compact_lists(int clusteNum, LightGrid* lightGrids, glm::uint* globalLightIndexList, glm::uint* packedGrids, uint16_t* packedIndexes, glm::uint sharedEntries = 0)
+	{
+		if (sharedEntries > 0)
+		{
+			assert(sharedEntries < COMPACT_LIST_MAX_ENTRIES);
+			for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+			{
+				packedGrids[tileIndex] = (lightGrids[tileIndex].offset << LIGHT_GRID_COUNT_BITS) | lightGrids[tileIndex].count;
+			}
+			for (glm::uint i = 0; i < sharedEntries; i++)
+			{
+				packedIndexes[i] = (uint16_t)globalLightIndexList[i];
+			}
+			return;
+		}
+
+		glm::uint packedCount = 0;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			LightGrid& lightGrid = lightGrids[tileIndex];
+			assert(packedCount < COMPACT_LIST_MAX_ENTRIES);
+			packedGrids[tileIndex] = (packedCount << LIGHT_GRID_COUNT_BITS) | lightGrid.count;
+			for (glm::uint i = 0; i < lightGrid.count; i++)
+			{
+				packedIndexes[packedCount + i] = (uint16_t)globalLightIndexList[lightGrid.offset + i];
+			}
+			packedCount += lightGrid.count;
+		}
+	}
+
+	/// stores every distinct light list once, clustes with the same lights point at one shared run.
+	/// the runs are written dense in tile order of their first cluste, empty lists take no entry.
+	/// table is scratch for the open addressing hash of the runs, returns the entries written
+	static glm::uint dedup_light_lists(int clusteNum, LightGrid* lightGrids, glm::uint* globalLightIndexList, LightGrid* sharedGrids, glm::uint* sharedList, std::vector<glm::uint>& table)
+	{
+		glm::uint tableSize = 1;
+		while (tableSize < 2 * (glm::uint)clusteNum)
+		{
+			tableSize <<= 1;
+		}
+		table.assign(tableSize, UINT32_MAX);
+
+		glm::uint sharedCount = 0;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			LightGrid& lightGrid = lightGrids[tileIndex];
+			if (lightGrid.count == 0)
+			{
+				sharedGrids[tileIndex] = { 0, 0 };
+				continue;
+			}
+
+			/// fnv-1a over the light indexes
+			glm::uint* lights = globalLightIndexList + lightGrid.offset;
+			uint32_t hash = 2166136261u;
+			for (glm::uint i = 0; i < lightGrid.count; i++)
+			{
+				hash = (hash ^ lights[i]) * 16777619u;
+			}
+
+			glm::uint slot = hash & (tableSize - 1);
+			while (table[slot] != UINT32_MAX)
+			{
+				LightGrid& shared = sharedGrids[table[slot]];
+				if (shared.count == lightGrid.count && memcmp(sharedList + shared.offset, lights, lightGrid.count * sizeof(glm::uint)) == 0)
+				{
+					break;
+				}
+				slot = (slot + 1) & (tableSize - 1);
+			}
+
+			if (table[slot] != UINT32_MAX)
+			{
+				sharedGrids[tileIndex] = sharedGrids[table[slot]];
+				continue;
+			}
+			table[slot] = tileIndex;
+			memcpy(sharedList + sharedCount, lights, lightGrid.count * sizeof(glm::uint));
+			sharedGrids[tileIndex] = { sharedCount, lightGrid.count };
+			sharedCount += lightGrid.count;
+		}
+		return sharedCount;
+	}
+
+	/// temporal update of the index lists of the last cull after the lights in [changedBegin, changedEnd) changed,
+	/// the view and the clustes being the same. oldViewLights holds the spheres those slots were culled with,
+	/// a negative radius for a slot that held no light. only the clustes the old or the new sphere of a changed
+	/// slot touches are culled again, the others keep their lists, so the result is the one of cluste_culling.
+	/// oldIndexList is scratch for the previous lists. returns the number of clustes culled again
+	static int cluste_culling_update(int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount,
+		int changedBegin, int changedEnd, glm::vec4* oldViewLights, LightGrid* lightGrids, glm::uint* globalLightIndexList, std::vector<glm::uint>& oldIndexList)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		oldIndexList.assign(globalLightIndexList, globalLightIndexList + count_list_entries(clusteNum, lightGrids));
+
+		int touchedNum = 0;
+		glm::uint globalIndexCount = 0;
+		for (int x = 0; x < xSize; x++)
+		{
+			for (int y = 0; y < ySize; y++)
+			{
+				for (int z = 0; z < zSize; z++)
+				{
+					glm::uint tileIndex = x + y * xSize + z * xSize * ySize;
+
+					glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+					glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+					const glm::vec4* planes = cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize);
+
+					bool isTouched = false;
+					for (int light = changedBegin; light < changedEnd && !isTouched; light++)
+					{
+						glm::vec4& oldViewLight = oldViewLights[light - changedBegin];
+						isTouched = (oldViewLight.w >= 0.0f && testSphereCluste(oldViewLight, minPointAABB, maxPointAABB, planes)) ||
+							(light < lightCount && viewLights[light].w >= 0.0f && testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, planes));
+					}
+
+					glm::uint visibleLightCount;
+					if (isTouched)
+					{
+						visibleLightCount = cluste_lights(viewLights, lightCount, minPointAABB, maxPointAABB, planes, globalLightIndexList + globalIndexCount);
+						touchedNum++;
+					}
+					else
+					{
+						visibleLightCount = lightGrids[tileIndex].count;
+						memcpy(globalLightIndexList + globalIndexCount, oldIndexList.data() + lightGrids[tileIndex].offset, sizeof(glm::uint) * visibleLightCount);
+					}
+
+					lightGrids[tileIndex].offset = globalIndexCount;
+					lightGrids[tileIndex].count = visibleLightCount;
+					globalIndexCount += visibleLightCount;
+				}
+			}
+		}
+		return touchedNum;
+	}
+
+	/// temporal update of the bitmasks, only the bits of the changed slots are tested again.
+	/// bits of slots at or past lightCount are cleared
+	static void cluste_culling_bitmask_update(int xSize, int ySize, int zSize, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount,
+		int changedBegin, int changedEnd, int maskWords, glm::uint* lightMasks)
+	{
+		int clusteNum = xSize * ySize * zSize;
+		for (int tileIndex = 0; tileIndex < clusteNum; tileIndex++)
+		{
+			glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+			glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+			const glm::vec4* planes = cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize);
+			glm::uint* lightMask = lightMasks + tileIndex * maskWords;
+			for (int light = changedBegin; light < changedEnd; light++)
+			{
+				lightMask[light >> 5] &= ~(1u << (light & 31));
+				if (light < lightCount && viewLights[light].w >= 0.0f && testSphereCluste(viewLights[light], minPointAABB, maxPointAABB, planes))
+				{
+					lightMask[light >> 5] |= 1u << (light & 31);
+				}
+			}
+		}
+	}
+
+	/// conservative spheres for amortized culling. lightMotion keeps the largest per frame view space motion of
+	/// every light, camera motion included, so a list culled now still holds every light it has to for staleFrames
+	/// more frames when the radius grows by staleFrames times that motion. returns false when a light moved faster
+	/// than before or was switched on or off, the stale lists do not cover it and every slice has to be culled again
+	static bool inflate_view_lights(int lightCount, glm::vec4* viewLights, glm::vec4* prevViewLights, float* lightMotion, int staleFrames, glm::vec4* inflatedLights)
+	{
+		bool isCovered = true;
+		for (int light = 0; light < lightCount; light++)
+		{
+			glm::vec4& viewLight = viewLights[light];
+			glm::vec4& prevViewLight = prevViewLights[light];
+			if ((viewLight.w >= 0.0f) != (prevViewLight.w >= 0.0f))
+			{
+				isCovered = false;
+			}
+			else if (viewLight.w >= 0.0f)
+			{
+				float motion = glm::length(glm::vec3(viewLight) - glm::vec3(prevViewLight)) + std::max(viewLight.w - prevViewLight.w, 0.0f);
+				if (motion > lightMotion[light])
+				{
+					/// headroom, a light speeding up slowly would refresh every slice every frame otherwise
+					lightMotion[light] = motion * AMORTIZED_MOTION_SLACK;
+					isCovered = false;
+				}
+			}
+
+			inflatedLights[light] = viewLight;
+			if (viewLight.w >= 0.0f)
+			{
+				inflatedLights[light].w += lightMotion[light] * staleFrames;
+			}
+		}
+		return isCovered;
+	}
+
+	/// amortized culling visits only the z slices with z % sliceGroups == sliceGroup, a sliceGroups of 1 visits all.
+	/// cull(tileIndex) handles one cluste, threadPool may be NULL for a serial run
+	template<typename ClusteCull>
+	static void cluste_culling_slices(ThreadPool* threadPool, int xSize, int ySize, int zSize, int sliceGroups, int sliceGroup, ClusteCull& cull)
+	{
+		int sliceSize = xSize * ySize;
+		int sliceNum = (zSize - sliceGroup + sliceGroups - 1) / sliceGroups;
+		int clusteNum = sliceNum * sliceSize;
+		int jobNum = threadPool != NULL ? std::min((int)threadPool->GetConcurrency(), clusteNum) : 1;
+		int clustesPerJob = (clusteNum + jobNum - 1) / jobNum;
+
+		auto cullJob = [&](int job)
+		{
+			int end = std::min((job + 1) * clustesPerJob, clusteNum);
+			for (int i = job * clustesPerJob; i < end; i++)
+			{
+				int z = sliceGroup + (i / sliceSize) * sliceGroups;
+				cull(z * sliceSize + i % sliceSize);
+			}
+		};
+
+		if (threadPool != NULL)
+			threadPool->ParallelFor(jobNum, cullJob);
+		else
+			cullJob(0);
+	}
+
+	/// amortized index lists: every cluste owns listStride entries at tileIndex * listStride, so the slices
+	/// that are not visited keep their lists in place. viewLights are the inflated spheres
+	static void cluste_culling_amortized(ThreadPool* threadPool, int xSize, int ySize, int zSize, int sliceGroups, int sliceGroup, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount,
+		int listStride, LightGrid* lightGrids, glm::uint* globalLightIndexList)
+	{
+		auto cull = [&](int tileIndex)
+		{
+			glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+			glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+			lightGrids[tileIndex].offset = tileIndex * listStride;
+			lightGrids[tileIndex].count = cluste_lights(viewLights, lightCount, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), globalLightIndexList + tileIndex * listStride);
+		};
+		cluste_culling_slices(threadPool, xSize, ySize, zSize, sliceGroups, sliceGroup, cull);
+	}
+
+	static void cluste_culling_bitmask_amortized(ThreadPool* threadPool, int xSize, int ySize, int zSize, int sliceGroups, int sliceGroup, VolumeTileAABB* clusteAABBs, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount,
+		int maskWords, glm::uint* lightMasks)
+	{
+		auto cull = [&](int tileIndex)
+		{
+			glm::vec3 minPointAABB = glm::vec3(clusteAABBs[tileIndex].minPoint);
+			glm::vec3 maxPointAABB = glm::vec3(clusteAABBs[tileIndex].maxPoint);
+			cluste_lights_bitmask(viewLights, lightCount, minPointAABB, maxPointAABB, cluste_tile_planes(tilePlanes, tileIndex, xSize, ySize), maskWords, lightMasks + tileIndex * maskWords);
+		};
+		cluste_culling_slices(threadPool, xSize, ySize, zSize, sliceGroups, sliceGroup, cull);
+	}
+
+	/// side planes of every screen tile in view space, 4 per tile. the planes go through the eye,
+	/// normals point into the tile so a sphere is outside when dot(n, center) < -radius
+	static void build_tile_planes(int xSize, int ySize, ScreenToView& screenToView, glm::vec4* tilePlanes)
+	{
+		float tileSizePx = screenToView.tileSizes[3];
+		for (int y = 0; y < ySize; y++)
+		{
+			for (int x = 0; x < xSize; x++)
+			{
+				glm::vec3 corners[4];	/// (x, y) (x+1, y) (x, y+1) (x+1, y+1)
+				for (int i = 0; i < 4; i++)
+				{
+					glm::vec4 screen = glm::vec4(glm::vec2(x + (i & 1), y + (i >> 1)) * tileSizePx, -1.0, 1.0);
+					corners[i] = glm::vec3(screen2View(screen, screenToView));
+				}
+				glm::vec3 center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+
+				static const int edges[4][2] = { { 0, 2 }, { 1, 3 }, { 0, 1 }, { 2, 3 } };
+				for (int i = 0; i < 4; i++)
+				{
+					glm::vec3 normal = glm::normalize(glm::cross(corners[edges[i][0]], corners[edges[i][1]]));
+					if (glm::dot(normal, center) < 0.0f)
+					{
+						normal = -normal;
+					}
+					tilePlanes[(x + y * xSize) * 4 + i] = glm::vec4(normal, 0.0f);
+				}
+			}
+		}
+	}
+
+	/// z-binning: lights sorted by view depth, every z bin keeps the first/last sorted light that reaches it
+	/// and every screen tile keeps a bitmask over the sorted lights. shading walks the tile mask words inside
+	/// the bin range, so memory is xSize * ySize masks + zSize bins instead of a list per cluste.
+	/// zBins[z] is (first, last), first > last for an empty bin. sortedLights maps a sorted slot to its light
+	static void cluste_culling_zbin(ThreadPool* threadPool, int xSize, int ySize, int zSize, ScreenToView& screenToView, glm::vec4* tilePlanes, glm::vec4* viewLights, int lightCount,
+		int maskWords, glm::uvec2* zBins, glm::uint* tileMasks, glm::uint* sortedLights)
+	{
+		/// pass 1: enabled lights sorted front to back
+		int sortedCount = 0;
+		for (int light = 0; light < lightCount; light++)
+		{
+			if (viewLights[light].w >= 0.0f)
+			{
+				sortedLights[sortedCount++] = light;
+			}
+		}
+		std::sort(sortedLights, sortedLights + sortedCount, [viewLights](glm::uint a, glm::uint b)
+		{
+			return viewLights[a].z > viewLights[b].z || (viewLights[a].z == viewLights[b].z && a < b);
+		});
+
+		/// pass 2: bin ranges, slices grow exponentially from zNear to zFar like the clustes
+		float zNear = screenToView.zNear;
+		float zFar = screenToView.zFar;
+		float sliceScale = (float)zSize / std::log(zFar / zNear);
+		for (int z = 0; z < zSize; z++)
+		{
+			zBins[z] = glm::uvec2(0xffffffff, 0);
+		}
+		for (int slot = 0; slot < sortedCount; slot++)
+		{
+			glm::vec4& viewLight = viewLights[sortedLights[slot]];
+			float depthNear = -viewLight.z - viewLight.w;
+			float depthFar = -viewLight.z + viewLight.w;
+			if (depthFar < zNear || depthNear > zFar)
+			{
+				continue;
+			}
+			/// one slice of padding each way, the shader's log2 bin index may round the other way at a boundary
+			int zFirst = depthNear <= zNear ? 0 : (int)(std::log(depthNear / zNear) * sliceScale) - 1;
+			int zLast = (int)(std::log(depthFar / zNear) * sliceScale) + 1;
+			zFirst = std::max(zFirst, 0);
+			zLast = std::min(zLast, zSize - 1);
+			for (int z = zFirst; z <= zLast; z++)
+			{
+				zBins[z].x = std::min(zBins[z].x, (glm::uint)slot);
+				zBins[z].y = std::max(zBins[z].y, (glm::uint)slot);
+			}
+		}
+
+		/// pass 3: tile masks, tiles are independent
+		int tileNum = xSize * ySize;
+		int jobNum = threadPool != NULL ? std::min((int)threadPool->GetConcurrency(), tileNum) : 1;
+		int tilesPerJob = (tileNum + jobNum - 1) / jobNum;
+		auto cull = [&](int job)
+		{
+			int tileEnd = std::min((job + 1) * tilesPerJob, tileNum);
+			for (int tile = job * tilesPerJob; tile < tileEnd; tile++)
+			{
+				glm::vec4* planes = tilePlanes + tile * 4;
+				glm::uint* tileMask = tileMasks + tile * maskWords;
+				memset(tileMask, 0, sizeof(glm::uint) * maskWords);
+				for (int slot = 0; slot < sortedCount; slot++)
+				{
+					glm::vec4& viewLight = viewLights[sortedLights[slot]];
+					glm::vec3 center = glm::vec3(viewLight);
+					bool inside = true;
+					for (int i = 0; i < 4 && inside; i++)
+					{
+						inside = glm::dot(glm::vec3(planes[i]), center) >= -viewLight.w;
+					}
+					if (inside)
+					{
+						tileMask[slot >> 5] |= 1u << (slot & 31);
+					}
+				}
+			}
+		};
+
+		if (threadPool != NULL)
+			threadPool->ParallelFor(jobNum, cull);
+		else
+			cull(0);
+	}
 }
 
 #endif // !__CLUSTE_CULLING_H__
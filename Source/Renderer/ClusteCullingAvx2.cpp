@@ -0,0 +1,47 @@
+/// built with /arch:AVX2 on msvc, the pragmas set the instruction set for gcc and clang
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+#include "ClusteCullingSimdKernel.h"
+
+namespace SimdCpu
+{
+	struct SimdAvx2
+	{
+		enum { Width = 8 };
+		typedef __m256 Float;
+
+		static inline Float Load(const float* p) { return _mm256_loadu_ps(p); }
+		static inline Float Set1(float v) { return _mm256_set1_ps(v); }
+		static inline Float Zero() { return _mm256_setzero_ps(); }
+		static inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+		static inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+		/// sqDist <= radius^2 for the enabled lights
+		static inline unsigned int Visible(Float sqDist, Float radius)
+		{
+			Float inside = _mm256_cmp_ps(sqDist, _mm256_mul_ps(radius, radius), _CMP_LE_OQ);
+			Float enabled = _mm256_cmp_ps(radius, _mm256_setzero_ps(), _CMP_GE_OQ);
+			return (unsigned int)_mm256_movemask_ps(_mm256_and_ps(inside, enabled));
+		}
+
+		/// !(a < b), true for nan like the scalar test
+		static inline unsigned int NotLess(Float a, Float b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NLT_UQ)); }
+	};
+
+	glm::uint cluste_lights_avx2(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices)
+	{
+		return cluste_lights_simd<SimdAvx2>(lights, minPoint, maxPoint, tilePlanes, maxLightCount, visibleLightIndices);
+	}
+};
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
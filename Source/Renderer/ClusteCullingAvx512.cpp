@@ -0,0 +1,47 @@
+/// built with /arch:AVX512 on msvc, the pragmas set the instruction set for gcc and clang
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#include <immintrin.h>
+
+#include "ClusteCullingSimdKernel.h"
+
+namespace SimdCpu
+{
+	struct SimdAvx512
+	{
+		enum { Width = 16 };
+		typedef __m512 Float;
+
+		static inline Float Load(const float* p) { return _mm512_loadu_ps(p); }
+		static inline Float Set1(float v) { return _mm512_set1_ps(v); }
+		static inline Float Zero() { return _mm512_setzero_ps(); }
+		static inline Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+		static inline Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+		static inline Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+		static inline Float Max(Float a, Float b) { return _mm512_max_ps(a, b); }
+
+		/// sqDist <= radius^2 for the enabled lights
+		static inline unsigned int Visible(Float sqDist, Float radius)
+		{
+			__mmask16 inside = _mm512_cmp_ps_mask(sqDist, _mm512_mul_ps(radius, radius), _CMP_LE_OQ);
+			__mmask16 enabled = _mm512_cmp_ps_mask(radius, _mm512_setzero_ps(), _CMP_GE_OQ);
+			return (unsigned int)(inside & enabled);
+		}
+
+		/// !(a < b), true for nan like the scalar test
+		static inline unsigned int NotLess(Float a, Float b) { return (unsigned int)_mm512_cmp_ps_mask(a, b, _CMP_NLT_UQ); }
+	};
+
+	glm::uint cluste_lights_avx512(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices)
+	{
+		return cluste_lights_simd<SimdAvx512>(lights, minPoint, maxPoint, tilePlanes, maxLightCount, visibleLightIndices);
+	}
+};
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,119 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "ClusteCullingSimd.h"
+
+namespace SimdCpu
+{
+	static SimdLevel DetectLevel()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse42 = (info[2] & (1 << 20)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx2 = false;
+		bool avx512f = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512f = (info[1] & (1 << 16)) != 0;
+		}
+
+		/// the os has to save the ymm and zmm registers too
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool ymmState = (xcr0 & 0x06) == 0x06;
+		bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+		if (avx512f && zmmState)
+			return SimdLevel_AVX512;
+		if (avx2 && ymmState)
+			return SimdLevel_AVX2;
+		if (sse42)
+			return SimdLevel_SSE4;
+		return SimdLevel_None;
+#else
+		/// the builtins check the os register state as well
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return SimdLevel_AVX512;
+		if (__builtin_cpu_supports("avx2"))
+			return SimdLevel_AVX2;
+		if (__builtin_cpu_supports("sse4.2"))
+			return SimdLevel_SSE4;
+		return SimdLevel_None;
+#endif
+	}
+
+	SimdLevel GetSupportedLevel()
+	{
+		static SimdLevel supportedLevel = DetectLevel();
+		return supportedLevel;
+	}
+
+	const char* GetLevelName(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel_SSE4:
+			return "SSE4";
+		case SimdLevel_AVX2:
+			return "AVX2";
+		case SimdLevel_AVX512:
+			return "AVX512";
+		default:
+			return "None";
+		}
+	}
+
+	ClusteLightsFunc GetClusteLights(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel_SSE4:
+			return cluste_lights_sse4;
+		case SimdLevel_AVX2:
+			return cluste_lights_avx2;
+		case SimdLevel_AVX512:
+			return cluste_lights_avx512;
+		default:
+			return NULL;
+		}
+	}
+
+	void BuildSoaLights(glm::vec4* viewLights, int lightCount, std::vector<float>& storage, SoaLights& lights)
+	{
+		int paddedCount = (lightCount + SIMD_LIGHT_PAD - 1) / SIMD_LIGHT_PAD * SIMD_LIGHT_PAD;
+		storage.resize(paddedCount * 4);
+		float* x = storage.data();
+		float* y = x + paddedCount;
+		float* z = y + paddedCount;
+		float* radius = z + paddedCount;
+
+		for (int light = 0; light < lightCount; light++)
+		{
+			x[light] = viewLights[light].x;
+			y[light] = viewLights[light].y;
+			z[light] = viewLights[light].z;
+			radius[light] = viewLights[light].w;
+		}
+		for (int light = lightCount; light < paddedCount; light++)
+		{
+			x[light] = 0.0f;
+			y[light] = 0.0f;
+			z[light] = 0.0f;
+			radius[light] = -1.0f;
+		}
+
+		lights.x = x;
+		lights.y = y;
+		lights.z = z;
+		lights.radius = radius;
+		lights.count = lightCount;
+	}
+};
@@ -0,0 +1,52 @@
+#ifndef __CLUSTE_CULLING_SIMD_H__
+#define	__CLUSTE_CULLING_SIMD_H__
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#define SIMD_LIGHT_PAD 16	/// widest vector in floats, the light arrays are padded to a multiple of it
+
+/// intrinsics culling backend, one translation unit per instruction set, picked at runtime by cpuid
+namespace SimdCpu
+{
+	enum SimdLevel
+	{
+		SimdLevel_None,
+		SimdLevel_SSE4,
+		SimdLevel_AVX2,
+		SimdLevel_AVX512,
+	};
+
+	/// view lights as struct of arrays, the padding lights are disabled. the instruction set units only
+	/// see plain pointers, so no inline library code gets compiled with their instruction set
+	struct SoaLights
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+		int count;
+	};
+
+	/// same lists as RawCpu::cluste_lights, clamped to maxLightCount. tilePlanes as in RawCpu::testSphereCluste
+	typedef glm::uint (*ClusteLightsFunc)(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices);
+
+	/// highest level the cpu and the os support, detected once
+	SimdLevel GetSupportedLevel();
+	const char* GetLevelName(SimdLevel level);
+
+	/// NULL for SimdLevel_None
+	ClusteLightsFunc GetClusteLights(SimdLevel level);
+
+	/// lights points into storage
+	void BuildSoaLights(glm::vec4* viewLights, int lightCount, std::vector<float>& storage, SoaLights& lights);
+
+	glm::uint cluste_lights_sse4(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices);
+	glm::uint cluste_lights_avx2(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices);
+	glm::uint cluste_lights_avx512(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices);
+};
+
+#endif // !__CLUSTE_CULLING_SIMD_H__
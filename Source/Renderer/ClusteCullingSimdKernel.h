@@ -0,0 +1,74 @@
+#ifndef __CLUSTE_CULLING_SIMD_KERNEL_H__
+#define	__CLUSTE_CULLING_SIMD_KERNEL_H__
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "ClusteCullingSimd.h"
+
+/// included once by every instruction set unit, V wraps the vector type:
+/// Width, Float, Load, Set1, Zero, Add, Sub, Mul, Max, Visible(sqDist, radius) and NotLess(a, b) -> lane mask
+namespace SimdCpu
+{
+	static inline int count_trailing_zeros(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (int)index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/// per axis distance is max(min - v, 0) + max(v - max, 0), one term is always 0,
+	/// so the sums round like RawCpu::sqDistPointAABB
+	template<typename V>
+	static glm::uint cluste_lights_simd(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices)
+	{
+		typename V::Float minX = V::Set1(minPoint.x);
+		typename V::Float minY = V::Set1(minPoint.y);
+		typename V::Float minZ = V::Set1(minPoint.z);
+		typename V::Float maxX = V::Set1(maxPoint.x);
+		typename V::Float maxY = V::Set1(maxPoint.y);
+		typename V::Float maxZ = V::Set1(maxPoint.z);
+		typename V::Float zero = V::Zero();
+
+		glm::uint visibleLightCount = 0;
+		for (int base = 0; base < lights.count && visibleLightCount < maxLightCount; base += V::Width)
+		{
+			typename V::Float x = V::Load(lights.x + base);
+			typename V::Float y = V::Load(lights.y + base);
+			typename V::Float z = V::Load(lights.z + base);
+			typename V::Float dx = V::Add(V::Max(V::Sub(minX, x), zero), V::Max(V::Sub(x, maxX), zero));
+			typename V::Float dy = V::Add(V::Max(V::Sub(minY, y), zero), V::Max(V::Sub(y, maxY), zero));
+			typename V::Float dz = V::Add(V::Max(V::Sub(minZ, z), zero), V::Max(V::Sub(z, maxZ), zero));
+			typename V::Float sqDist = V::Add(V::Add(V::Mul(dx, dx), V::Mul(dy, dy)), V::Mul(dz, dz));
+
+			/// lanes past the count hold padding lights, which are disabled
+			typename V::Float radius = V::Load(lights.radius + base);
+			unsigned int hits = V::Visible(sqDist, radius);
+			if (tilePlanes != NULL && hits != 0)
+			{
+				/// the sums round like the glm::dot of RawCpu::testSpherePlanes
+				typename V::Float negRadius = V::Sub(zero, radius);
+				for (int i = 0; i < 4; i++)
+				{
+					typename V::Float distance = V::Add(V::Add(V::Add(V::Mul(V::Set1(tilePlanes[i].x), x), V::Mul(V::Set1(tilePlanes[i].y), y)), V::Mul(V::Set1(tilePlanes[i].z), z)), V::Set1(tilePlanes[i].w));
+					hits &= V::NotLess(distance, negRadius);
+				}
+			}
+			while (hits != 0 && visibleLightCount < maxLightCount)
+			{
+				visibleLightIndices[visibleLightCount] = base + count_trailing_zeros(hits);
+				visibleLightCount += 1;
+				hits &= hits - 1;
+			}
+		}
+
+		return visibleLightCount;
+	}
+};
+
+#endif // !__CLUSTE_CULLING_SIMD_KERNEL_H__
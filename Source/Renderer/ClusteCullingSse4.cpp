@@ -0,0 +1,47 @@
+/// x64 msvc needs no /arch for sse, the pragmas set the instruction set for gcc and clang
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse4.2")
+#endif
+
+#include <immintrin.h>
+
+#include "ClusteCullingSimdKernel.h"
+
+namespace SimdCpu
+{
+	struct SimdSse4
+	{
+		enum { Width = 4 };
+		typedef __m128 Float;
+
+		static inline Float Load(const float* p) { return _mm_loadu_ps(p); }
+		static inline Float Set1(float v) { return _mm_set1_ps(v); }
+		static inline Float Zero() { return _mm_setzero_ps(); }
+		static inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+		static inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+
+		/// sqDist <= radius^2 for the enabled lights
+		static inline unsigned int Visible(Float sqDist, Float radius)
+		{
+			Float inside = _mm_cmple_ps(sqDist, _mm_mul_ps(radius, radius));
+			Float enabled = _mm_cmpge_ps(radius, _mm_setzero_ps());
+			return (unsigned int)_mm_movemask_ps(_mm_and_ps(inside, enabled));
+		}
+
+		/// !(a < b), true for nan like the scalar test
+		static inline unsigned int NotLess(Float a, Float b) { return (unsigned int)_mm_movemask_ps(_mm_cmpnlt_ps(a, b)); }
+	};
+
+	glm::uint cluste_lights_sse4(const SoaLights& lights, const glm::vec3& minPoint, const glm::vec3& maxPoint, const glm::vec4* tilePlanes, glm::uint maxLightCount, glm::uint* visibleLightIndices)
+	{
+		return cluste_lights_simd<SimdSse4>(lights, minPoint, maxPoint, tilePlanes, maxLightCount, visibleLightIndices);
+	}
+};
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
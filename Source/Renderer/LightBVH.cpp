@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cfloat>
+
+#include "LightBVH.h"
+
+LightBVH::LightBVH()
+{
+	view_lights = NULL;
+}
+
+LightBVH::~LightBVH()
+{
+}
+
+void LightBVH::Build(glm::vec4* viewLights, int lightCount)
+{
+	nodes.clear();
+	lights.clear();
+	for (int light = 0; light < lightCount; light++)
+	{
+		if (viewLights[light].w >= 0.0f)
+		{
+			lights.push_back(light);
+		}
+	}
+	if (lights.empty())
+	{
+		return;
+	}
+
+	view_lights = viewLights;
+	nodes.reserve(2 * (lights.size() / LIGHT_BVH_LEAF_SIZE + 1));
+	BuildNode(0, (int)lights.size(), 0);
+	view_lights = NULL;
+}
+
+glm::uint LightBVH::BuildNode(int begin, int end, int depth)
+{
+	glm::vec3 minPoint = glm::vec3(FLT_MAX);
+	glm::vec3 maxPoint = glm::vec3(-FLT_MAX);
+	glm::vec3 minCenter = glm::vec3(FLT_MAX);
+	glm::vec3 maxCenter = glm::vec3(-FLT_MAX);
+	for (int i = begin; i < end; i++)
+	{
+		glm::vec4& viewLight = view_lights[lights[i]];
+		glm::vec3 center = glm::vec3(viewLight);
+		minPoint = glm::min(minPoint, center - viewLight.w);
+		maxPoint = glm::max(maxPoint, center + viewLight.w);
+		minCenter = glm::min(minCenter, center);
+		maxCenter = glm::max(maxCenter, center);
+	}
+
+	glm::uint nodeIndex = (glm::uint)nodes.size();
+	Node node;
+	node.min_point = minPoint;
+	node.max_point = maxPoint;
+	node.first = begin;
+	node.count = end - begin;
+	nodes.push_back(node);
+
+	if (end - begin <= LIGHT_BVH_LEAF_SIZE || depth + 1 >= LIGHT_BVH_MAX_DEPTH)
+	{
+		return nodeIndex;
+	}
+
+	/// split at the median center along the longest axis
+	glm::vec3 extent = maxCenter - minCenter;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	int mid = (begin + end) / 2;
+	glm::vec4* viewLights = view_lights;
+	std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end, [viewLights, axis](glm::uint a, glm::uint b)
+	{
+		return viewLights[a][axis] < viewLights[b][axis];
+	});
+
+	BuildNode(begin, mid, depth + 1);
+	glm::uint right = BuildNode(mid, end, depth + 1);
+	nodes[nodeIndex].first = right;
+	nodes[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+void LightBVH::Query(const glm::vec3& minPoint, const glm::vec3& maxPoint, std::vector<glm::uint>& result) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	glm::uint stack[LIGHT_BVH_MAX_DEPTH + 1];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		glm::uint nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+		if (node.min_point.x > maxPoint.x || node.max_point.x < minPoint.x ||
+			node.min_point.y > maxPoint.y || node.max_point.y < minPoint.y ||
+			node.min_point.z > maxPoint.z || node.max_point.z < minPoint.z)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			result.insert(result.end(), lights.begin() + node.first, lights.begin() + node.first + node.count);
+		}
+		else
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef __LIGHT_BVH_H__
+#define	__LIGHT_BVH_H__
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#define LIGHT_BVH_LEAF_SIZE 4
+#define LIGHT_BVH_MAX_DEPTH 64
+
+/// bounding volume hierarchy over the view space light spheres.
+/// rebuilt every frame by median splits on the longest axis, nodes are stored depth first
+class LightBVH
+{
+	struct Node
+	{
+		glm::vec3 min_point;
+		glm::uint first;	/// leaf: first entry of lights, inner: index of the right child, the left one follows the node
+		glm::vec3 max_point;
+		glm::uint count;	/// light count of a leaf, 0 for an inner node
+	};
+
+public:
+	LightBVH();
+	virtual ~LightBVH();
+
+	/// viewLights: center in xyz, radius in w, lights with a negative radius are left out
+	void Build(glm::vec4* viewLights, int lightCount);
+
+	/// appends every light whose bounds overlap the box, in no particular order
+	void Query(const glm::vec3& minPoint, const glm::vec3& maxPoint, std::vector<glm::uint>& result) const;
+
+	int GetNodeCount() { return (int)nodes.size(); }
+
+private:
+	glm::uint BuildNode(int begin, int end, int depth);
+
+private:
+	std::vector<Node> nodes;
+	std::vector<glm::uint> lights;
+	glm::vec4* view_lights;	/// only valid during Build
+};
+
+#endif // !__LIGHT_BVH_H__
@@ -0,0 +1,224 @@
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Light.h"
+#include "VRenderer.h"
+#include "LightStore.h"
+
+LightStore::LightStore()
+{
+	count = 0;
+	dirty_begin = INT_MAX;
+	dirty_end = 0;
+	version = 0;
+}
+
+LightStore::~LightStore()
+{
+}
+
+LightHandle LightStore::Add(PointLight* light)
+{
+	unsigned int index;
+	if (!free_handles.empty())
+	{
+		index = free_handles.back();
+		free_handles.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)handle_slots.size();
+		if (index > LIGHT_HANDLE_INDEX_MASK)
+		{
+			throw std::runtime_error("too many point lights for the light handle table!");
+		}
+		handle_slots.push_back(-1);
+		handle_generations.push_back(0);
+	}
+
+	int slot = count++;
+	pos_x.resize(count);
+	pos_y.resize(count);
+	pos_z.resize(count);
+	radius.resize(count);
+	enabled_bits.resize((count + 31) / 32, 0);
+	color.resize(count);
+	ambient_intensity.resize(count);
+	diffuse_intensity.resize(count);
+	specular_intensity.resize(count);
+	attenuation_constant.resize(count);
+	attenuation_linear.resize(count);
+	attenuation_exp.resize(count);
+	slot_handles.resize(count);
+
+	LightHandle handle = (handle_generations[index] << LIGHT_HANDLE_INDEX_BITS) | index;
+	slot_handles[slot] = handle;
+	handle_slots[index] = slot;
+	Write(slot, light);
+	enabled_bits[slot >> 5] |= 1u << (slot & 31);
+	MarkDirty(slot, slot + 1);
+
+	return handle;
+}
+
+int LightStore::GetSlot(LightHandle handle)
+{
+	unsigned int index = handle & LIGHT_HANDLE_INDEX_MASK;
+	if (handle == INVALID_LIGHT_HANDLE || index >= handle_slots.size())
+	{
+		return -1;
+	}
+	if (handle_generations[index] != (handle >> LIGHT_HANDLE_INDEX_BITS))
+	{
+		return -1;
+	}
+	return handle_slots[index];
+}
+
+void LightStore::Update(LightHandle handle, PointLight* light)
+{
+	int slot = GetSlot(handle);
+	assert(slot >= 0 && "stale or invalid light handle");
+	if (slot < 0)
+	{
+		return;
+	}
+	Write(slot, light);
+	MarkDirty(slot, slot + 1);
+}
+
+void LightStore::SetEnabled(LightHandle handle, bool enabled)
+{
+	int slot = GetSlot(handle);
+	assert(slot >= 0 && "stale or invalid light handle");
+	if (slot < 0)
+	{
+		return;
+	}
+	if (enabled)
+		enabled_bits[slot >> 5] |= 1u << (slot & 31);
+	else
+		enabled_bits[slot >> 5] &= ~(1u << (slot & 31));
+	MarkDirty(slot, slot + 1);
+}
+
+void LightStore::Remove(LightHandle handle)
+{
+	int slot = GetSlot(handle);
+	assert(slot >= 0 && "stale or invalid light handle");
+	if (slot < 0)
+	{
+		return;
+	}
+
+	int last = count - 1;
+	if (slot != last)
+	{
+		Move(slot, last);
+	}
+
+	/// the vacated last slot is dirty too, it has to be disabled on the gpu
+	MarkDirty(slot, count);
+	enabled_bits[last >> 5] &= ~(1u << (last & 31));
+	Free(handle & LIGHT_HANDLE_INDEX_MASK);
+	count = last;
+}
+
+void LightStore::Clear()
+{
+	MarkDirty(0, count);
+	std::fill(enabled_bits.begin(), enabled_bits.end(), 0);
+	for (int slot = 0; slot < count; slot++)
+	{
+		Free(slot_handles[slot] & LIGHT_HANDLE_INDEX_MASK);
+	}
+	count = 0;
+}
+
+void LightStore::Free(unsigned int index)
+{
+	handle_slots[index] = -1;
+	/// wraps inside the generation bits, skipping the pattern of INVALID_LIGHT_HANDLE
+	handle_generations[index] = (handle_generations[index] + 1) & (INVALID_LIGHT_HANDLE >> LIGHT_HANDLE_INDEX_BITS);
+	if (((handle_generations[index] << LIGHT_HANDLE_INDEX_BITS) | index) == INVALID_LIGHT_HANDLE)
+	{
+		handle_generations[index] = 0;
+	}
+	free_handles.push_back(index);
+}
+
+void LightStore::GetLightData(int slot, PointLightData* data)
+{
+	if (slot >= count)
+	{
+		memset(data, 0, sizeof(PointLightData));
+		return;
+	}
+
+	data->pos = glm::vec3(pos_x[slot], pos_y[slot], pos_z[slot]);
+	data->radius = radius[slot];
+	data->color = color[slot];
+	data->enabled = IsEnabled(slot) ? 1 : 0;
+	data->ambient_intensity = ambient_intensity[slot];
+	data->diffuse_intensity = diffuse_intensity[slot];
+	data->specular_intensity = specular_intensity[slot];
+	data->attenuation_constant = attenuation_constant[slot];
+	data->attenuation_linear = attenuation_linear[slot];
+	data->attenuation_exp = attenuation_exp[slot];
+	data->padding = glm::vec2(0.0f);
+}
+
+void LightStore::ClearDirty()
+{
+	dirty_begin = INT_MAX;
+	dirty_end = 0;
+}
+
+void LightStore::Write(int slot, PointLight* light)
+{
+	glm::vec3& pos = light->GetPosition();
+	pos_x[slot] = pos.x;
+	pos_y[slot] = pos.y;
+	pos_z[slot] = pos.z;
+	radius[slot] = light->GetRadius();
+	color[slot] = light->GetColor();
+	ambient_intensity[slot] = light->GetAmbientIntensity();
+	diffuse_intensity[slot] = light->GetDiffuseIntensity();
+	specular_intensity[slot] = light->GetSpecularIntensity();
+	attenuation_constant[slot] = light->GetAttenuationConstant();
+	attenuation_linear[slot] = light->GetAttenuationLinear();
+	attenuation_exp[slot] = light->GetAttenuationExp();
+}
+
+void LightStore::Move(int dstSlot, int srcSlot)
+{
+	pos_x[dstSlot] = pos_x[srcSlot];
+	pos_y[dstSlot] = pos_y[srcSlot];
+	pos_z[dstSlot] = pos_z[srcSlot];
+	radius[dstSlot] = radius[srcSlot];
+	color[dstSlot] = color[srcSlot];
+	ambient_intensity[dstSlot] = ambient_intensity[srcSlot];
+	diffuse_intensity[dstSlot] = diffuse_intensity[srcSlot];
+	specular_intensity[dstSlot] = specular_intensity[srcSlot];
+	attenuation_constant[dstSlot] = attenuation_constant[srcSlot];
+	attenuation_linear[dstSlot] = attenuation_linear[srcSlot];
+	attenuation_exp[dstSlot] = attenuation_exp[srcSlot];
+
+	if (IsEnabled(srcSlot))
+		enabled_bits[dstSlot >> 5] |= 1u << (dstSlot & 31);
+	else
+		enabled_bits[dstSlot >> 5] &= ~(1u << (dstSlot & 31));
+
+	slot_handles[dstSlot] = slot_handles[srcSlot];
+	handle_slots[slot_handles[dstSlot] & LIGHT_HANDLE_INDEX_MASK] = dstSlot;
+}
+
+void LightStore::MarkDirty(int begin, int end)
+{
+	dirty_begin = std::min(dirty_begin, begin);
+	dirty_end = std::max(dirty_end, end);
+	version++;
+}
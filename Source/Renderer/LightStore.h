@@ -0,0 +1,95 @@
+#ifndef __LIGHT_STORE_H__
+#define	__LIGHT_STORE_H__
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/// low bits index the handle table, high bits carry the generation of that entry
+/// so a handle kept past its Remove or Clear is told apart from the one reusing its entry
+typedef unsigned int LightHandle;
+#define INVALID_LIGHT_HANDLE 0xffffffff
+#define LIGHT_HANDLE_INDEX_BITS 20
+#define LIGHT_HANDLE_INDEX_MASK ((1u << LIGHT_HANDLE_INDEX_BITS) - 1)
+
+struct PointLightData;
+class PointLight;
+
+/// every point light of the scene in structure-of-arrays layout.
+/// slots [0, count) are packed, a remove moves the last slot into the hole,
+/// handles stay valid across removes. changed slots are tracked as one dirty range
+class LightStore
+{
+public:
+	LightStore();
+	virtual ~LightStore();
+
+	LightHandle Add(PointLight* light);
+	void Update(LightHandle handle, PointLight* light);
+	void SetEnabled(LightHandle handle, bool enabled);
+	void Remove(LightHandle handle);
+	void Clear();
+
+	int GetCount() { return count; }
+	/// -1 for an invalid, removed or recycled handle
+	int GetSlot(LightHandle handle);
+	bool IsValid(LightHandle handle) { return GetSlot(handle) >= 0; }
+
+	/// culling inputs, one lane per slot
+	float* GetPosX() { return pos_x.data(); }
+	float* GetPosY() { return pos_y.data(); }
+	float* GetPosZ() { return pos_z.data(); }
+	float* GetRadius() { return radius.data(); }
+	glm::uint* GetEnabledBits() { return enabled_bits.data(); }
+	bool IsEnabled(int slot) { return ((enabled_bits[slot >> 5] >> (slot & 31)) & 1) != 0; }
+
+	/// shader layout of a slot, slots past count come out disabled
+	void GetLightData(int slot, PointLightData* data);
+
+	/// slots changed since the last ClearDirty, may reach past count after a remove
+	bool IsDirty() { return dirty_begin < dirty_end; }
+	int GetDirtyBegin() { return dirty_begin; }
+	int GetDirtyEnd() { return dirty_end; }
+	void ClearDirty();
+	void MarkAllDirty() { MarkDirty(0, count); }
+
+	/// bumped by every change, dirty ranges are cleared each upload but the version keeps counting
+	unsigned int GetVersion() { return version; }
+
+private:
+	void Write(int slot, PointLight* light);
+	void Move(int dstSlot, int srcSlot);
+	void MarkDirty(int begin, int end);
+	void Free(unsigned int index);
+
+private:
+	int count;
+
+	std::vector<float> pos_x;
+	std::vector<float> pos_y;
+	std::vector<float> pos_z;
+	std::vector<float> radius;
+	std::vector<glm::uint> enabled_bits;
+
+	std::vector<glm::vec3> color;
+	std::vector<float> ambient_intensity;
+	std::vector<float> diffuse_intensity;
+	std::vector<float> specular_intensity;
+	std::vector<float> attenuation_constant;
+	std::vector<float> attenuation_linear;
+	std::vector<float> attenuation_exp;
+
+	std::vector<LightHandle> slot_handles;
+	std::vector<int> handle_slots;	/// -1 for a free handle
+	std::vector<unsigned int> handle_generations;	/// bumped each time a handle is freed
+	std::vector<unsigned int> free_handles;
+
+	int dirty_begin;
+	int dirty_end;
+	unsigned int version;
+};
+
+#endif // !__LIGHT_STORE_H__
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <chrono>
 #include <windows.h>
 
 #include <vulkan/vulkan.h>
@@ -6,22 +7,25 @@
 
 #include "Application/Application.h"
 #include "Common/Utils.h"
+#include "Common/ThreadPool.h"
+#include "Common/IspcTasks.h"
 #include "Camera.h"
 #include "Texture.h"
 #include "Material.h"
 #include "Light.h"
 #include "VRenderer.h"
 
+#undef max
+#undef min
+
 #include "ClusteCulling.h"
 
-/// prevent multi-define
+#ifdef CLUSTE_USE_ISPC
+/// prevent multi-define, the generated prototypes then take the renderer's own structs
 #define __ISPC_STRUCT_LightGrid__
+#define __ISPC_STRUCT_VolumeTileAABB__
 #include "Ispc/cluste_culling_ispc.h"
-
-#undef max
-#undef min
-
-static ispc::PointLightDataISPC* pointLightISPCDatas = NULL;
+#endif
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -43,6 +47,56 @@ VulkanRenderer::VulkanRenderer(GLFWwindow* win)
 	isClusteShading = false;
 	isIspc = false;
 	isCpuClusteCull = false;
+	isMultiThreadCull = false;
+	isSimdCull = false;
+	isExactCull = false;
+	isOverflowCheck = false;
+	isTemporalReuse = true;
+	isAsyncCull = true;
+	cullWaitTime = 0.0;
+	light_list_slot = 0;
+	light_slots_to_clear = 0;
+	view_light_slot = 0;
+	comp_timeline_value = 0;
+	comp_counts_value = 0;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		light_list_values[slot] = 0;
+		view_light_values[slot] = 0;
+	}
+	isUploadLists = true;
+	framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	frame_index = 0;
+	last_frame_index = 0;
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		light_datas_dirty_begin[frame] = INT_MAX;
+		light_datas_dirty_end[frame] = 0;
+	}
+	isListUploadPending = false;
+	light_grids_dirty_bytes = 0;
+	light_indexes_dirty_bytes = 0;
+	memset(&cull_state, 0, sizeof(ClusteCullState));
+	is_cull_state_valid = false;
+	cull_light_version = 0;
+	cull_light_count = 0;
+	changed_lights_begin = INT_MAX;
+	changed_lights_end = 0;
+	cullReuse = CullReuse_Full;
+	isCullSetupChanged = true;
+	isCompDispatched = false;
+	amortizedSliceGroups = AMORTIZED_SLICE_GROUPS;
+	amortized_slice_group = 0;
+	amortized_slice_groups = 0;
+	light_list_entries = 0;
+	aabb_list_entries = 0;
+	exact_list_entries = 0;
+	light_list_overflows = 0;
+	simdLevel = SimdCpu::GetSupportedLevel();
+	cpuCullMethod = CpuCull_ClusteMajor;
+	clusteListFormat = ClusteList_Indexes;
+	isDedupLists = false;
+	list_dedup_ratio = 1.0f;
 	last_command_buffer_idx = UINT_MAX;
 	CreateInstance();
 	CreateSurface();
@@ -53,11 +107,15 @@ VulkanRenderer::VulkanRenderer(GLFWwindow* win)
 	CreateRenderPass();
 	CreateGraphicsPipeline();
 
-	pointLightISPCDatas = new ispc::PointLightDataISPC[MAX_LIGHT_NUM];
+	cull_thread_pool = new ThreadPool();
+	IspcTasks::SetThreadPool(cull_thread_pool);
+	cull_job_thread = new ThreadPool(1);
+	light_bvh = new LightBVH();
+	light_store = new LightStore();
+	light_capacity = INIT_LIGHT_CAPACITY;
 
 	/// set computer number and tile size in screen space
-	tile_size_x = (unsigned int)std::ceilf(Application::Inst()->GetWidth() / (float)CLUSTE_X);;
-	group_num = glm::uvec3(CLUSTE_X, CLUSTE_Y, CLUSTE_Z);
+	UpdateClusteGridSize(DEFAULT_CLUSTE_TILE_SIZE, DEFAULT_CLUSTE_Z);
 
 	///if( isClusteShading )
 		InitializeClusteRendering();
@@ -100,7 +158,7 @@ void VulkanRenderer::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2;	/// timeline semaphores
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -153,30 +211,52 @@ void VulkanRenderer::CleanImage(VkImage& image, VkDeviceMemory& imageMem, VkImag
 
 void VulkanRenderer::CleanUp()
 {
-	if (pointLightISPCDatas != NULL)
+	if (cull_job_thread != NULL)
 	{
-		delete[] pointLightISPCDatas;
-		pointLightISPCDatas = NULL;
+		if (cull_job.valid())
+			cull_job.wait();
+		delete cull_job_thread;
+		cull_job_thread = NULL;
 	}
 
-	for (int i = 0; i < light_uniform_buffers.size(); i++)
+	if (cull_thread_pool != NULL)
 	{
-		UnmapBufferMemory(light_uniform_buffer_memorys[i]);
-		CleanBuffer(light_uniform_buffers[i], light_uniform_buffer_memorys[i]);
+		IspcTasks::SetThreadPool(NULL);
+		delete cull_thread_pool;
+		cull_thread_pool = NULL;
 	}
 
-	UnmapBufferMemory(transform_uniform_buffer_memory);
-	CleanBuffer(transform_uniform_buffer, transform_uniform_buffer_memory);
+	if (light_bvh != NULL)
+	{
+		delete light_bvh;
+		light_bvh = NULL;
+	}
+
+	if (light_store != NULL)
+	{
+		delete light_store;
+		light_store = NULL;
+	}
+
+	ReleaseLightBuffers();
+
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		UnmapBufferMemory(transform_uniform_buffer_memory[frame]);
+		CleanBuffer(transform_uniform_buffer[frame], transform_uniform_buffer_memory[frame]);
+	}
 
 	vkDestroyImageView(device, depth_image_view, nullptr);
 	vkDestroyImage(device, depth_image, nullptr);
 	vkFreeMemory(device, depth_image_memory, nullptr);
 
-	vkDestroySemaphore(device, compute_finished_semaphore, nullptr);
-	vkDestroySemaphore(device, render_finished_semaphore, nullptr);
-	vkDestroySemaphore(device, image_available_semaphore, nullptr);
-	vkDestroyFence(device, in_flight_fence, nullptr);
-	vkDestroyFence(device, comp_wait_fence, nullptr);
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		vkDestroySemaphore(device, render_finished_semaphores[frame], nullptr);
+		vkDestroySemaphore(device, image_available_semaphores[frame], nullptr);
+		vkDestroyFence(device, in_flight_fences[frame], nullptr);
+	}
+	vkDestroySemaphore(device, comp_timeline_semaphore, nullptr);
 
 	vkDestroyCommandPool(device, command_pool, nullptr);
 	vkDestroyDescriptorSetLayout(device, desc_layout, nullptr);
@@ -196,11 +276,9 @@ void VulkanRenderer::CleanUp()
 		vkDestroyDescriptorPool(device, comp_desc_pool, nullptr);
 		vkDestroyDescriptorSetLayout(device, comp_desc_layout, nullptr);
 		vkDestroyCommandPool(device, comp_command_pool, nullptr);
-		vkDestroyPipeline(device, comp_pipelines[0], nullptr);
-		vkDestroyPipeline(device, comp_pipelines[1], nullptr);
+		vkDestroyPipeline(device, comp_pipeline, nullptr);
 		vkDestroyPipelineLayout(device, comp_pipeline_layout, nullptr);
 
-		vkDestroyShaderModule(device, comp_cluste_shader_module, nullptr);
 		vkDestroyShaderModule(device, cluste_cull_shader_module, nullptr);
 	}
 
@@ -275,13 +353,26 @@ bool VulkanRenderer::IsDeviceSuitable(VkPhysicalDevice device)
 	bool extensionsSupported = CheckDeviceExtensionSupport(device);
 	QueueFamilyIndices indices = FindQueueFamilies(device);
 
+	/// the compute and graphics queues sync on a timeline semaphore
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &timelineFeatures;
+	bool timelineSupported = false;
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+		timelineSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+	}
+
 	bool swapChainAdequate = false;
 	if (extensionsSupported) {
 		SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) && indices.isComplete() && extensionsSupported && swapChainAdequate;
+	return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) && indices.isComplete() && extensionsSupported && swapChainAdequate && timelineSupported;
 }
 
 bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
@@ -402,8 +493,12 @@ void VulkanRenderer::CreateLogicDevice()
 	}
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &timelineFeatures;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
@@ -897,9 +992,9 @@ void VulkanRenderer::CreateGraphicsPipeline()
 
 	VkDescriptorSetLayoutBinding layoutBinding2 = {};
 	layoutBinding2.binding = 2;
-	layoutBinding2.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	layoutBinding2.descriptorCount = MAX_LIGHT_NUM;
-	layoutBinding2.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	layoutBinding2.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBinding2.descriptorCount = 1;
+	layoutBinding2.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	layoutBinding2.pImmutableSamplers = NULL;
 
 	VkDescriptorSetLayoutBinding lightIndexLayoutBinding = {};
@@ -1020,28 +1115,22 @@ void VulkanRenderer::CreateCompPipeline()
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
 
-	/// pipeline
-	VkComputePipelineCreateInfo computePipelineCreateInfos[2] = {
+	/// group size goes in as specialization constant 0, the dispatch divides by the same value
+	uint32_t groupSize = CLUSTE_CULL_GROUP_SIZE;
+	VkSpecializationMapEntry groupSizeEntry = { 0, 0, sizeof(uint32_t) };
+	VkSpecializationInfo specializationInfo = { 1, &groupSizeEntry, sizeof(uint32_t), &groupSize };
+
+	/// pipeline, cluste aabbs are built on cpu by UpdateClusteAABBs
+	VkComputePipelineCreateInfo computePipelineCreateInfo = {
+		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		0, 0,
 		{
-			VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-			0, 0,
-			{
-				VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-				0, 0, VK_SHADER_STAGE_COMPUTE_BIT, comp_cluste_shader_module = createShaderModule(Utils::readFile("Data/shader/cluste_calc.spv")), "main", 0
-			},
-			comp_pipeline_layout, 0, 0
-		},
-		{
-			VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-			0, 0,
-			{
-				VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-				0, 0, VK_SHADER_STAGE_COMPUTE_BIT, cluste_cull_shader_module = createShaderModule(Utils::readFile("Data/shader/cluste_culling.spv")), "main", 0
-			},
-			comp_pipeline_layout, 0, 0
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			0, 0, VK_SHADER_STAGE_COMPUTE_BIT, cluste_cull_shader_module = createShaderModule(Utils::readFile("Data/shader/cluste_culling.spv")), "main", &specializationInfo
 		},
+		comp_pipeline_layout, 0, 0
 	};
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 2, computePipelineCreateInfos, nullptr, comp_pipelines) != VK_SUCCESS) {
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &comp_pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create compute pipeline!");
 	}
 
@@ -1057,7 +1146,7 @@ void VulkanRenderer::CreateCompPipeline()
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = comp_command_pool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 2 * swap_chain_images.size();
+	allocInfo.commandBufferCount = swap_chain_images.size();
 
 	if (vkAllocateCommandBuffers(device, &allocInfo, comp_command_buffers) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate command buffers!");
@@ -1092,98 +1181,88 @@ void VulkanRenderer::CreateCompDescriptorSets()
 	AllocateCompDescriptorSets(comp_desc_set);
 
 	/// tile aabb
-	VkDeviceSize bufferSize = sizeof(VolumeTileAABB) * CLUSTE_NUM;
+	VkDeviceSize bufferSize = sizeof(VolumeTileAABB) * cluste_num;
 	CreateLocalStorageBuffer(&tile_aabbs_buffer_data, (uint32_t)bufferSize, tile_aabbs_buffer, tile_aabbs_buffer_memory);
 	tile_aabbs_buffer_info.buffer = tile_aabbs_buffer;
 	tile_aabbs_buffer_info.offset = 0;
 	tile_aabbs_buffer_info.range = bufferSize;
+	tile_aabbs_camera = NULL;
 
 	/// screen to view
 	bufferSize = sizeof(ScreenToView);
-	CreateLocalStorageBuffer(&screen_to_view_buffer_data, (uint32_t)bufferSize, screen_to_view_buffer, screen_to_view_buffer_memory);
-	ScreenToView* stv = (ScreenToView*)screen_to_view_buffer_data;
-	stv->screenDimensions = glm::uvec2(Application::Inst()->GetWidth(), Application::Inst()->GetHeight());
-	stv->tileSizes = glm::uvec4(group_num, tile_size_x);
-	screen_to_view_buffer_info.buffer = screen_to_view_buffer;
-	screen_to_view_buffer_info.offset = 0;
-	screen_to_view_buffer_info.range = bufferSize;
-
-	/// light datas
-	bufferSize = sizeof(PointLightData) * MAX_LIGHT_NUM;
-	CreateLocalStorageBuffer(&light_datas_buffer_data, (uint32_t)bufferSize, light_datas_buffer, light_datas_buffer_memory);
-	light_datas_buffer_info.buffer = light_datas_buffer;
-	light_datas_buffer_info.offset = 0;
-	light_datas_buffer_info.range = bufferSize;
-
-	/// light indexes
-	bufferSize = sizeof(glm::uint) * MAX_LIGHT_NUM * CLUSTE_NUM;
-	///if( !isIspc )
-		CreateGraphicsStorageBuffer(NULL, (uint32_t)bufferSize, gpu_light_indexes_buffer, gpu_light_indexes_buffer_memory);
-	///else
-		CreateLocalStorageBuffer(&light_indexes_buffer_data, (uint32_t)bufferSize, local_light_indexes_buffer, local_light_indexes_buffer_memory);
-	local_light_indexes_buffer_info.buffer = local_light_indexes_buffer;
-	local_light_indexes_buffer_info.offset = 0;
-	local_light_indexes_buffer_info.range = bufferSize;
-	gpu_light_indexes_buffer_info.buffer = gpu_light_indexes_buffer;
-	gpu_light_indexes_buffer_info.offset = 0;
-	gpu_light_indexes_buffer_info.range = bufferSize;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		CreateLocalStorageBuffer(&screen_to_view_slot_data[slot], (uint32_t)bufferSize, screen_to_view_buffer[slot], screen_to_view_buffer_memory[slot]);
+		ScreenToView* stv = (ScreenToView*)screen_to_view_slot_data[slot];
+		stv->screenDimensions = glm::uvec2(Application::Inst()->GetWidth(), Application::Inst()->GetHeight());
+		stv->tileSizes = glm::uvec4(group_num, tile_size_x);
+		stv->isExactCull = 0;
+		stv->isCompactList = 0;
+		screen_to_view_buffer_info[slot].buffer = screen_to_view_buffer[slot];
+		screen_to_view_buffer_info[slot].offset = 0;
+		screen_to_view_buffer_info[slot].range = bufferSize;
+	}
+	screen_to_view_buffer_data = screen_to_view_slot_data[light_list_slot];
+
+	/// view space lights and light indexes grow with the light count, see CreateLightBuffers
 
 	/// light grids
-	bufferSize = sizeof(LightGrid) * CLUSTE_NUM;
-	///if( !isIspc )
-		CreateGraphicsStorageBuffer(NULL, (uint32_t)bufferSize, gpu_light_grids_buffer, gpu_light_grids_buffer_memory);
-	///else
-		CreateLocalStorageBuffer(&light_grids_buffer_data, (uint32_t)bufferSize, local_light_grids_buffer, local_light_grids_buffer_memory);
-	gpu_light_grids_buffer_info.buffer = gpu_light_grids_buffer;
-	gpu_light_grids_buffer_info.offset = 0;
-	gpu_light_grids_buffer_info.range = bufferSize;
-	local_light_grids_buffer_info.buffer = local_light_grids_buffer;
-	local_light_grids_buffer_info.offset = 0;
-	local_light_grids_buffer_info.range = bufferSize;
-
-	/// global index count
-	bufferSize = sizeof(glm::uint);
-	CreateLocalStorageBuffer(&index_count_buffer_data, (uint32_t)bufferSize, index_count_buffer, index_count_buffer_memory);
-	index_count_buffer_info.buffer = index_count_buffer;
-	index_count_buffer_info.offset = 0;
-	index_count_buffer_info.range = bufferSize;
+	bufferSize = sizeof(LightGrid) * cluste_num;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		CreateGraphicsStorageBuffer(NULL, (uint32_t)bufferSize, gpu_light_grids_buffer[slot], gpu_light_grids_buffer_memory[slot]);
+		gpu_light_grids_buffer_info[slot].buffer = gpu_light_grids_buffer[slot];
+		gpu_light_grids_buffer_info[slot].offset = 0;
+		gpu_light_grids_buffer_info[slot].range = bufferSize;
+		CreateLocalStorageBuffer(&light_grids_slot_data[slot], (uint32_t)bufferSize, local_light_grids_buffer[slot], local_light_grids_buffer_memory[slot]);
+		memset(light_grids_slot_data[slot], 0, (size_t)bufferSize);
+		local_light_grids_buffer_info[slot].buffer = local_light_grids_buffer[slot];
+		local_light_grids_buffer_info[slot].offset = 0;
+		local_light_grids_buffer_info[slot].range = bufferSize;
+	}
+	light_grids_buffer_data = light_grids_slot_data[light_list_slot];
+
+	/// global index count followed by the overflowed cluste count
+	bufferSize = sizeof(glm::uint) * 2;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		CreateLocalStorageBuffer(&index_count_slot_data[slot], (uint32_t)bufferSize, index_count_buffer[slot], index_count_buffer_memory[slot]);
+		index_count_buffer_info[slot].buffer = index_count_buffer[slot];
+		index_count_buffer_info[slot].offset = 0;
+		index_count_buffer_info[slot].range = bufferSize;
+	}
+	/// the new counters hold no totals of the dispatches before
+	comp_counts_value = comp_timeline_value;
 }
 
 void VulkanRenderer::ReleaseCompDescriptorSets()
 {
 	UnmapBufferMemory(tile_aabbs_buffer_memory);
-	UnmapBufferMemory(screen_to_view_buffer_memory);
-	UnmapBufferMemory(light_datas_buffer_memory);
-	///if (isIspc)
+	CleanBuffer(tile_aabbs_buffer, tile_aabbs_buffer_memory);
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
 	{
-		UnmapBufferMemory(local_light_indexes_buffer_memory);
-		UnmapBufferMemory(local_light_grids_buffer_memory);
+		UnmapBufferMemory(screen_to_view_buffer_memory[slot]);
+		UnmapBufferMemory(local_light_grids_buffer_memory[slot]);
+		UnmapBufferMemory(index_count_buffer_memory[slot]);
+		CleanBuffer(screen_to_view_buffer[slot], screen_to_view_buffer_memory[slot]);
+		CleanBuffer(local_light_grids_buffer[slot], local_light_grids_buffer_memory[slot]);
+		CleanBuffer(gpu_light_grids_buffer[slot], gpu_light_grids_buffer_memory[slot]);
+		CleanBuffer(index_count_buffer[slot], index_count_buffer_memory[slot]);
 	}
-	UnmapBufferMemory(index_count_buffer_memory);
-	CleanBuffer(tile_aabbs_buffer, tile_aabbs_buffer_memory);
-	CleanBuffer(screen_to_view_buffer, screen_to_view_buffer_memory);
-	CleanBuffer(light_datas_buffer, light_datas_buffer_memory);
-	CleanBuffer(local_light_indexes_buffer, local_light_indexes_buffer_memory);
-	CleanBuffer(local_light_grids_buffer, local_light_grids_buffer_memory);
-	CleanBuffer(gpu_light_indexes_buffer, gpu_light_indexes_buffer_memory);
-	CleanBuffer(gpu_light_grids_buffer, gpu_light_grids_buffer_memory);
-	CleanBuffer(index_count_buffer, index_count_buffer_memory);
 	FreeCompDescriptorSets(comp_desc_set);
 }
 
 void VulkanRenderer::UpdateComputeDescriptorSet()
 {
-	vkWaitForFences(device, 1, &comp_wait_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(device, 1, &comp_wait_fence);
 	/*
 	VolumeTileAABB* volumnAABBs = (VolumeTileAABB*)tile_aabbs_buffer_data;
 	LightGrid* lightGrids = (LightGrid*)light_grids_buffer_data;
 	glm::uint* lightIndexs = (glm::uint*)light_indexes_buffer_data;
-	for (int i = 0; i < CLUSTE_NUM; i++)
+	for (int i = 0; i < cluste_num; i++)
 	{
 		LightGrid* lightGrid = lightGrids + i;
 		glm::uint* lightIndex = lightIndexs + lightGrid->offset;
-		if (i == CLUSTE_NUM/2+144*5)
+		if (i == cluste_num/2+144*5)
 		{
 			printf("total light count(%d) offset(%d) for cluste(%d):", lightGrid->count, lightGrid->offset, i);
 			for (int j = 0; j < lightGrid->count; j++)
@@ -1198,6 +1277,13 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 		}
 	}*/
 
+	PollComputeCounts();
+
+	/// the slot's last dispatch is done, see SelectLightListSlot. the shader only appends so the counters restart from zero
+	glm::uint* indexCounts = (glm::uint*)index_count_slot_data[light_list_slot];
+	indexCounts[0] = 0;
+	indexCounts[1] = 0;
+
 	/// set descriptor sets
 	std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
 	descriptorWrites[0] = {};
@@ -1216,7 +1302,7 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	descriptorWrites[1].dstSet = comp_desc_set[active_command_buffer_idx];
 	descriptorWrites[1].descriptorCount = 1;
 	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrites[1].pBufferInfo = &screen_to_view_buffer_info;
+	descriptorWrites[1].pBufferInfo = &screen_to_view_buffer_info[light_list_slot];
 	descriptorWrites[1].dstArrayElement = 0;
 	descriptorWrites[1].dstBinding = 1;
 
@@ -1226,7 +1312,7 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	descriptorWrites[2].dstSet = comp_desc_set[active_command_buffer_idx];
 	descriptorWrites[2].descriptorCount = 1;
 	descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrites[2].pBufferInfo = &light_datas_buffer_info;
+	descriptorWrites[2].pBufferInfo = &light_views_buffer_info[view_light_slot];
 	descriptorWrites[2].dstArrayElement = 0;
 	descriptorWrites[2].dstBinding = 2;
 
@@ -1236,7 +1322,7 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	descriptorWrites[3].dstSet = comp_desc_set[active_command_buffer_idx];
 	descriptorWrites[3].descriptorCount = 1;
 	descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrites[3].pBufferInfo = &gpu_light_indexes_buffer_info;
+	descriptorWrites[3].pBufferInfo = &gpu_light_indexes_buffer_info[light_list_slot];
 	descriptorWrites[3].dstArrayElement = 0;
 	descriptorWrites[3].dstBinding = 3;
 
@@ -1246,7 +1332,7 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	descriptorWrites[4].dstSet = comp_desc_set[active_command_buffer_idx];
 	descriptorWrites[4].descriptorCount = 1;
 	descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrites[4].pBufferInfo = &gpu_light_grids_buffer_info;
+	descriptorWrites[4].pBufferInfo = &gpu_light_grids_buffer_info[light_list_slot];
 	descriptorWrites[4].dstArrayElement = 0;
 	descriptorWrites[4].dstBinding = 4;
 
@@ -1256,7 +1342,7 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	descriptorWrites[5].dstSet = comp_desc_set[active_command_buffer_idx];
 	descriptorWrites[5].descriptorCount = 1;
 	descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrites[5].pBufferInfo = &index_count_buffer_info;
+	descriptorWrites[5].pBufferInfo = &index_count_buffer_info[light_list_slot];
 	descriptorWrites[5].dstArrayElement = 0;
 	descriptorWrites[5].dstBinding = 5;
 
@@ -1265,27 +1351,15 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-	/// comp 1
-	int command_buffer_idx = active_command_buffer_idx * 2 + 0;
-	vkBeginCommandBuffer(comp_command_buffers[command_buffer_idx], &beginInfo);
-
-	vkCmdBindPipeline(comp_command_buffers[command_buffer_idx], VK_PIPELINE_BIND_POINT_COMPUTE, comp_pipelines[0]);
-
-	vkCmdBindDescriptorSets(comp_command_buffers[command_buffer_idx], VK_PIPELINE_BIND_POINT_COMPUTE, comp_pipeline_layout, 0, 1, &comp_desc_set[active_command_buffer_idx], 0, nullptr);
-
-	vkCmdDispatch(comp_command_buffers[command_buffer_idx], group_num.x, group_num.y, group_num.z);
-
-	vkEndCommandBuffer(comp_command_buffers[command_buffer_idx]);
-
-	/// comp 2
-	command_buffer_idx = active_command_buffer_idx * 2 + 1;
+	/// cluste culling, tile aabbs come from UpdateClusteAABBs
+	int command_buffer_idx = active_command_buffer_idx;
 	vkBeginCommandBuffer(comp_command_buffers[command_buffer_idx], &beginInfo);
 
-	vkCmdBindPipeline(comp_command_buffers[command_buffer_idx], VK_PIPELINE_BIND_POINT_COMPUTE, comp_pipelines[1]);
+	vkCmdBindPipeline(comp_command_buffers[command_buffer_idx], VK_PIPELINE_BIND_POINT_COMPUTE, comp_pipeline);
 
 	vkCmdBindDescriptorSets(comp_command_buffers[command_buffer_idx], VK_PIPELINE_BIND_POINT_COMPUTE, comp_pipeline_layout, 0, 1, &comp_desc_set[active_command_buffer_idx], 0, nullptr);
 
-	vkCmdDispatch(comp_command_buffers[command_buffer_idx], 1, 1, 6);
+	vkCmdDispatch(comp_command_buffers[command_buffer_idx], (cluste_num + CLUSTE_CULL_GROUP_SIZE - 1) / CLUSTE_CULL_GROUP_SIZE, 1, 1);
 
 	QueueFamilyIndices indices = FindQueueFamilies(physical_device);
 	VkBufferMemoryBarrier buffer_barriers[2] =
@@ -1297,9 +1371,9 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 			0,
 			indices.computeFamily.value(),
 			indices.graphicsFamily.value(),
-			gpu_light_indexes_buffer_info.buffer,
+			gpu_light_indexes_buffer_info[light_list_slot].buffer,
 			0,
-			gpu_light_indexes_buffer_info.range,
+			gpu_light_indexes_buffer_info[light_list_slot].range,
 		},
 		{
 			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -1308,9 +1382,9 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 			0,
 			indices.computeFamily.value(),
 			indices.graphicsFamily.value(),
-			gpu_light_grids_buffer_info.buffer,
+			gpu_light_grids_buffer_info[light_list_slot].buffer,
 			0,
-			gpu_light_grids_buffer_info.range,
+			gpu_light_grids_buffer_info[light_list_slot].range,
 		},
 	};
 
@@ -1325,15 +1399,26 @@ void VulkanRenderer::UpdateComputeDescriptorSet()
 
 	vkEndCommandBuffer(comp_command_buffers[command_buffer_idx]);	
 	
-	VkSemaphore signalSemaphores[] = { compute_finished_semaphore };
+	/// dispatch n signals n, the host checks the counter instead of waiting on a fence
+	comp_timeline_value++;
+	light_list_values[light_list_slot] = comp_timeline_value;
+	view_light_values[view_light_slot] = comp_timeline_value;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &comp_timeline_value;
+
+	VkSemaphore signalSemaphores[] = { comp_timeline_semaphore };
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 2;
-	submitInfo.pCommandBuffers = &comp_command_buffers[active_command_buffer_idx * 2];
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &comp_command_buffers[command_buffer_idx];
 	submitInfo.pSignalSemaphores = signalSemaphores;
 	submitInfo.signalSemaphoreCount = 1;
 
-	if (vkQueueSubmit(comp_queue, 1, &submitInfo, comp_wait_fence) != VK_SUCCESS)
+	if (vkQueueSubmit(comp_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to submit compute command buffer!");
 	}
@@ -1543,7 +1628,7 @@ void VulkanRenderer::CreateImageBuffer(void* imageData, uint32_t length, VkBuffe
 void VulkanRenderer::CreateLocalStorageBuffer(void** data, uint32_t length, VkBuffer& buffer, VkDeviceMemory& mem)
 {
 	VkDeviceSize bufferSize = length;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, mem);
+	CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, mem);
 
 	vkMapMemory(device, mem, 0, bufferSize, 0, data);
 }
@@ -1551,7 +1636,7 @@ void VulkanRenderer::CreateLocalStorageBuffer(void** data, uint32_t length, VkBu
 void VulkanRenderer::CreateGraphicsStorageBuffer(void** data, uint32_t length, VkBuffer& buffer, VkDeviceMemory& mem)
 {
 	VkDeviceSize bufferSize = length;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, mem);
+	CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, mem);
 	///CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, mem);
 
 	///vkMapMemory(device, mem, 0, bufferSize, 0, data);
@@ -1605,6 +1690,12 @@ void VulkanRenderer::CreateCommandBuffers()
 	if (vkAllocateCommandBuffers(device, &allocInfo, command_buffers.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate command buffers!");
 	}
+
+	/// copies of the cpu culled lists, submitted ahead of the frame's commands
+	upload_command_buffers.resize(swap_chain_framebuffers.size());
+	if (vkAllocateCommandBuffers(device, &allocInfo, upload_command_buffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
 }
 
 void VulkanRenderer::UpdateMaterial(Material* mat)
@@ -1619,7 +1710,7 @@ void VulkanRenderer::UpdateMaterial(Material* mat)
 		descriptorWrites[0].dstSet = descSets[active_command_buffer_idx];
 		descriptorWrites[0].descriptorCount = 1;
 		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].pBufferInfo = &transform_uniform_buffer_info;
+		descriptorWrites[0].pBufferInfo = &transform_uniform_buffer_info[frame_index];
 		descriptorWrites[0].dstArrayElement = 0;
 		descriptorWrites[0].dstBinding = 0;
 
@@ -1637,9 +1728,9 @@ void VulkanRenderer::UpdateMaterial(Material* mat)
 		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[2].pNext = NULL;
 		descriptorWrites[2].dstSet = descSets[active_command_buffer_idx];
-		descriptorWrites[2].descriptorCount = light_uniform_buffer_infos.size();
-		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[2].pBufferInfo = light_uniform_buffer_infos.data();
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[2].pBufferInfo = &light_datas_buffer_info[frame_index];
 		descriptorWrites[2].dstArrayElement = 0;
 		descriptorWrites[2].dstBinding = 2;
 
@@ -1649,10 +1740,10 @@ void VulkanRenderer::UpdateMaterial(Material* mat)
 		descriptorWrites[3].dstSet = descSets[active_command_buffer_idx];
 		descriptorWrites[3].descriptorCount = 1;
 		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		if(!isClusteShading || isCpuClusteCull)
-			descriptorWrites[3].pBufferInfo = &local_light_indexes_buffer_info;
+		if(!isClusteShading || (isCpuClusteCull && !isUploadLists))
+			descriptorWrites[3].pBufferInfo = &local_light_indexes_buffer_info[light_list_slot];
 		else
-			descriptorWrites[3].pBufferInfo = &gpu_light_indexes_buffer_info;
+			descriptorWrites[3].pBufferInfo = &gpu_light_indexes_buffer_info[light_list_slot];
 		descriptorWrites[3].dstArrayElement = 0;
 		descriptorWrites[3].dstBinding = 3;
 
@@ -1662,10 +1753,10 @@ void VulkanRenderer::UpdateMaterial(Material* mat)
 		descriptorWrites[4].dstSet = descSets[active_command_buffer_idx];
 		descriptorWrites[4].descriptorCount = 1;
 		descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		if (!isClusteShading || isCpuClusteCull)
-			descriptorWrites[4].pBufferInfo = &local_light_grids_buffer_info;
+		if (!isClusteShading || (isCpuClusteCull && !isUploadLists))
+			descriptorWrites[4].pBufferInfo = &local_light_grids_buffer_info[light_list_slot];
 		else
-			descriptorWrites[4].pBufferInfo = &gpu_light_grids_buffer_info;
+			descriptorWrites[4].pBufferInfo = &gpu_light_grids_buffer_info[light_list_slot];
 		descriptorWrites[4].dstArrayElement = 0;
 		descriptorWrites[4].dstBinding = 4;
 
@@ -1731,8 +1822,8 @@ void VulkanRenderer::SetCamPos(glm::vec3& pos)
 	memcpy(&transData->cam_pos, &pos, sizeof(glm::vec3));
 	transData->zNear = zNear;
 	transData->zFar = zFar;
-	transData->scale = (float)CLUSTE_Z / std::log2f(zFar / zNear);
-	transData->bias = -((float)CLUSTE_Z * std::log2f(zNear) / std::log2f(zFar / zNear));
+	transData->scale = (float)group_num.z / std::log2f(zFar / zNear);
+	transData->bias = -((float)group_num.z * std::log2f(zNear) / std::log2f(zFar / zNear));
 	transData->isClusteShading = isClusteShading;
 }
 
@@ -1756,33 +1847,19 @@ void VulkanRenderer::CreateUniformBuffers()
 {
 	/// transform uniform buffer
 	VkDeviceSize bufferSize = sizeof(TransformData);
-	CreateUniformBuffer(&transform_uniform_buffer_data, (uint32_t)bufferSize, transform_uniform_buffer, transform_uniform_buffer_memory);
-
-	transform_uniform_buffer_info.buffer = transform_uniform_buffer;
-	transform_uniform_buffer_info.offset = 0;
-	transform_uniform_buffer_info.range = bufferSize;
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		CreateUniformBuffer(&transform_uniform_slot_data[frame], (uint32_t)bufferSize, transform_uniform_buffer[frame], transform_uniform_buffer_memory[frame]);
+		transform_uniform_buffer_info[frame].buffer = transform_uniform_buffer[frame];
+		transform_uniform_buffer_info[frame].offset = 0;
+		transform_uniform_buffer_info[frame].range = bufferSize;
+	}
+	transform_uniform_buffer_data = transform_uniform_slot_data[frame_index];
 
 	TransformData* transData = (TransformData*)transform_uniform_buffer_data;
 	transData->tileSizes = glm::uvec4(group_num, tile_size_x);
 
-	for (int i = 0; i < MAX_LIGHT_NUM; i++)
-	{
-		void* light_uniform_buffer_data;
-		VkBuffer light_uniform_buffer;
-		VkDeviceMemory light_uniform_buffer_memory;
-		VkDescriptorBufferInfo light_uniform_buffer_info;
-
-		bufferSize = sizeof(PointLightData);
-		CreateUniformBuffer(&light_uniform_buffer_data, (uint32_t)bufferSize, light_uniform_buffer, light_uniform_buffer_memory);
-		light_uniform_buffer_info.buffer = light_uniform_buffer;
-		light_uniform_buffer_info.offset = 0;
-		light_uniform_buffer_info.range = bufferSize;
-
-		light_uniform_buffer_datas.push_back(light_uniform_buffer_data);
-		light_uniform_buffers.push_back(light_uniform_buffer);
-		light_uniform_buffer_memorys.push_back(light_uniform_buffer_memory);
-		light_uniform_buffer_infos.push_back(light_uniform_buffer_info);
-	}
+	CreateLightBuffers();
 }
 
 void VulkanRenderer::CreateDescriptorSetsPool()
@@ -1792,8 +1869,8 @@ void VulkanRenderer::CreateDescriptorSetsPool()
 	typeCounts[0].descriptorCount = swap_chain_images.size() * MAX_MATERIAL_NUM;
 	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	typeCounts[1].descriptorCount = swap_chain_images.size() * MAX_MATERIAL_NUM;
-	typeCounts[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	typeCounts[2].descriptorCount = swap_chain_images.size() * MAX_MATERIAL_NUM * MAX_LIGHT_NUM;
+	typeCounts[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	typeCounts[2].descriptorCount = swap_chain_images.size() * MAX_MATERIAL_NUM;
 	typeCounts[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	typeCounts[3].descriptorCount = swap_chain_images.size() * MAX_MATERIAL_NUM;
 	typeCounts[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -1872,15 +1949,26 @@ void VulkanRenderer::CreateSemaphores()
 	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &image_available_semaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &render_finished_semaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &compute_finished_semaphore) != VK_SUCCESS ||
-		vkCreateFence(device, &fenceInfo, nullptr, &in_flight_fence) != VK_SUCCESS ||
-		vkCreateFence(device, &fenceInfo, nullptr, &comp_wait_fence) != VK_SUCCESS) {
+	/// frame fences start signaled, the first wait on each returns at once
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &image_available_semaphores[frame]) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &render_finished_semaphores[frame]) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, nullptr, &in_flight_fences[frame]) != VK_SUCCESS) {
+
+			throw std::runtime_error("failed to create semaphores!");
+		}
+	}
 
+	VkSemaphoreTypeCreateInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = comp_timeline_value;
+	semaphoreInfo.pNext = &timelineInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &comp_timeline_semaphore) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create semaphores!");
 	}
-	vkResetFences(device, 1, &in_flight_fence);
+	images_in_flight.assign(swap_chain_images.size(), VK_NULL_HANDLE);
 }
 
 void VulkanRenderer::CreateTextureSampler(VkSampler* sampler)
@@ -1913,51 +2001,142 @@ void VulkanRenderer::DestroyTextureSampler(VkSampler* sampler)
 	vkDestroySampler(device, *sampler, nullptr);
 }
 
-void VulkanRenderer::AddLight(PointLight* light)
+LightHandle VulkanRenderer::AddLight(PointLight* light)
 {
-	PointLightData lightData;
-	lightData.color = light->GetColor();
-	lightData.pos = light->GetPosition();
-	lightData.radius = light->GetRadius();
-	lightData.enabled = 1;
-	lightData.ambient_intensity = light->GetAmbientIntensity();
-	lightData.diffuse_intensity = light->GetDiffuseIntensity();
-	lightData.specular_intensity = light->GetSpecularIntensity();
-	lightData.attenuation_constant = light->GetAttenuationConstant();
-	lightData.attenuation_linear = light->GetAttenuationLinear();
-	lightData.attenuation_exp = light->GetAttenuationExp();
-	light_infos.push_back(lightData);
+	/// grow here rather than in RenderBegin, scenes adding many lights reserve up front
+	ReserveLights(light_store->GetCount() + 1);
+	return light_store->Add(light);
+}
 
-	int idx = light_infos.size() - 1;
-	memcpy(light_uniform_buffer_datas[idx], &lightData, sizeof(PointLightData));
+void VulkanRenderer::UpdateLight(LightHandle handle, PointLight* light)
+{
+	light_store->Update(handle, light);
+}
 
-	///if (isClusteShading)
-	{	
-		///if (!isCpuClusteCull)
-		{
-			// for clust shading compute data
-			memcpy((unsigned char*)light_datas_buffer_data + idx * sizeof(PointLightData), &lightData, sizeof(PointLightData));
-		}
-		///else
-		{
-			/// set ISPC light
-			memcpy(&pointLightISPCDatas[idx].color, &lightData.color, sizeof(glm::vec3));
-			memcpy(&pointLightISPCDatas[idx].pos, &lightData.pos, sizeof(glm::vec3));
-			pointLightISPCDatas[idx].radius = lightData.radius;
-			pointLightISPCDatas[idx].enabled = lightData.enabled;
-			pointLightISPCDatas[idx].ambient_intensity = lightData.ambient_intensity;
-			pointLightISPCDatas[idx].diffuse_intensity = lightData.diffuse_intensity;
-			pointLightISPCDatas[idx].specular_intensity = lightData.specular_intensity;
-			pointLightISPCDatas[idx].attenuation_constant = lightData.attenuation_constant;
-			pointLightISPCDatas[idx].attenuation_linear = lightData.attenuation_linear;
-			pointLightISPCDatas[idx].attenuation_exp = lightData.attenuation_exp;
-		}
-	}
+void VulkanRenderer::RemoveLight(LightHandle handle)
+{
+	light_store->Remove(handle);
 }
 
 void VulkanRenderer::ClearLight()
 {
-	light_infos.clear();
+	light_store->Clear();
+}
+
+void VulkanRenderer::ReserveLights(unsigned int lightNum)
+{
+	if (lightNum <= light_capacity)
+	{
+		return;
+	}
+
+	/// grow geometrically so a scene adding lights one by one only reallocates log(n) times
+	unsigned int capacity = light_capacity;
+	while (capacity < lightNum)
+	{
+		capacity *= 2;
+	}
+
+	vkDeviceWaitIdle(device);
+	ReleaseLightBuffers();
+	light_capacity = capacity;
+	CreateLightBuffers();
+}
+
+void VulkanRenderer::CreateLightBuffers()
+{
+	light_index_capacity = std::min(light_capacity, (unsigned int)MAX_LIGHTS_PER_CLUSTE);
+	light_mask_words = (light_capacity + 31) / 32;
+
+	/// light datas for shading
+	VkDeviceSize bufferSize = sizeof(PointLightData) * light_capacity;
+	for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+	{
+		CreateLocalStorageBuffer(&light_datas_slot_data[frame], (uint32_t)bufferSize, light_datas_buffer[frame], light_datas_buffer_memory[frame]);
+		light_datas_buffer_info[frame].buffer = light_datas_buffer[frame];
+		light_datas_buffer_info[frame].offset = 0;
+		light_datas_buffer_info[frame].range = bufferSize;
+	}
+	light_datas_buffer_data = light_datas_slot_data[frame_index];
+
+	/// view space lights, the range follows the light count every frame
+	bufferSize = sizeof(glm::vec4) * light_capacity;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		CreateLocalStorageBuffer(&light_views_slot_data[slot], (uint32_t)bufferSize, light_views_buffer[slot], light_views_buffer_memory[slot]);
+		light_views_buffer_info[slot].buffer = light_views_buffer[slot];
+		light_views_buffer_info[slot].offset = 0;
+		light_views_buffer_info[slot].range = bufferSize;
+	}
+	light_views_buffer_data = light_views_slot_data[view_light_slot];
+
+	/// light indexes, the cpu side may hold bitmasks instead and uploads whichever into the gpu buffer.
+	/// z-binning stores the tile masks followed by the sorted light map in the same buffer
+	bufferSize = sizeof(glm::uint) * std::max(std::max(light_index_capacity, light_mask_words) * cluste_num, group_num.x * group_num.y * light_mask_words + light_capacity);
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		CreateGraphicsStorageBuffer(NULL, (uint32_t)bufferSize, gpu_light_indexes_buffer[slot], gpu_light_indexes_buffer_memory[slot]);
+		gpu_light_indexes_buffer_info[slot].buffer = gpu_light_indexes_buffer[slot];
+		gpu_light_indexes_buffer_info[slot].offset = 0;
+		gpu_light_indexes_buffer_info[slot].range = bufferSize;
+		CreateLocalStorageBuffer(&light_indexes_slot_data[slot], (uint32_t)bufferSize, local_light_indexes_buffer[slot], local_light_indexes_buffer_memory[slot]);
+		memset(light_indexes_slot_data[slot], 0, (size_t)bufferSize);
+		local_light_indexes_buffer_info[slot].buffer = local_light_indexes_buffer[slot];
+		local_light_indexes_buffer_info[slot].offset = 0;
+		local_light_indexes_buffer_info[slot].range = bufferSize;
+	}
+	light_indexes_buffer_data = light_indexes_slot_data[light_list_slot];
+
+	/// new buffers hold nothing, every light has to be written again
+	light_store->MarkAllDirty();
+	is_cull_state_valid = false;
+}
+
+void VulkanRenderer::ReleaseLightBuffers()
+{
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		UnmapBufferMemory(light_views_buffer_memory[slot]);
+		CleanBuffer(light_views_buffer[slot], light_views_buffer_memory[slot]);
+		UnmapBufferMemory(light_datas_buffer_memory[slot]);
+		CleanBuffer(light_datas_buffer[slot], light_datas_buffer_memory[slot]);
+		UnmapBufferMemory(local_light_indexes_buffer_memory[slot]);
+		CleanBuffer(local_light_indexes_buffer[slot], local_light_indexes_buffer_memory[slot]);
+		CleanBuffer(gpu_light_indexes_buffer[slot], gpu_light_indexes_buffer_memory[slot]);
+	}
+}
+
+void VulkanRenderer::UploadLights()
+{
+	/// AddLight keeps the buffers large enough, no device wait on the frame path
+	assert(light_store->GetCount() <= (int)light_capacity);
+
+	TransformData* transData = (TransformData*)transform_uniform_buffer_data;
+	transData->lightCount = light_store->GetCount();
+
+	/// every frame's copy of the light buffer has to see the changed slots once
+	if (light_store->IsDirty())
+	{
+		int dirtyEnd = std::min(light_store->GetDirtyEnd(), (int)light_capacity);
+		for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+		{
+			light_datas_dirty_begin[frame] = std::min(light_datas_dirty_begin[frame], light_store->GetDirtyBegin());
+			light_datas_dirty_end[frame] = std::max(light_datas_dirty_end[frame], dirtyEnd);
+		}
+		changed_lights_begin = std::min(changed_lights_begin, light_store->GetDirtyBegin());
+		changed_lights_end = std::max(changed_lights_end, dirtyEnd);
+		light_store->ClearDirty();
+	}
+
+	/// only the slots changed since this copy was last written
+	PointLightData* lightDatas = (PointLightData*)light_datas_buffer_data;
+	int dirtyEnd = std::min(light_datas_dirty_end[frame_index], (int)light_capacity);
+	for (int slot = light_datas_dirty_begin[frame_index]; slot < dirtyEnd; slot++)
+	{
+		light_store->GetLightData(slot, lightDatas + slot);
+	}
+	light_datas_dirty_begin[frame_index] = INT_MAX;
+	light_datas_dirty_end[frame_index] = 0;
 }
 
 void VulkanRenderer::SetScreenToViewData(ScreenToView* stv)
@@ -1972,10 +2151,475 @@ void VulkanRenderer::SetScreenToViewData(ScreenToView* stv)
 	stv->zFar = camera->GetFarDistance();
 }
 
+void VulkanRenderer::UpdateClusteGridSize(unsigned int tileSize, unsigned int zSlices)
+{
+	tile_size_x = tileSize;
+	group_num.x = (unsigned int)std::ceil(Application::Inst()->GetWidth() / (float)tileSize);
+	group_num.y = (unsigned int)std::ceil(Application::Inst()->GetHeight() / (float)tileSize);
+	group_num.z = zSlices;
+	cluste_num = group_num.x * group_num.y * group_num.z;
+}
+
+void VulkanRenderer::SetClusteGrid(unsigned int tileSize, unsigned int zSlices)
+{
+	if (tileSize == 0 || zSlices == 0)
+	{
+		throw std::runtime_error("invalid cluste grid!");
+	}
+	if (tileSize == tile_size_x && zSlices == group_num.z)
+	{
+		return;
+	}
+
+	/// cluste buffers are read by the frames in flight
+	vkDeviceWaitIdle(device);
+	ReleaseCompDescriptorSets();
+	ReleaseLightBuffers();
+
+	UpdateClusteGridSize(tileSize, zSlices);
+
+	CreateCompDescriptorSets();
+	CreateLightBuffers();
+
+	TransformData* transData = (TransformData*)transform_uniform_buffer_data;
+	transData->tileSizes = glm::uvec4(group_num, tile_size_x);
+}
+
+void VulkanRenderer::UpdateLightListEntries(glm::uint entries)
+{
+	light_list_entries = entries;
+	if (isExactCull)
+		exact_list_entries = entries;
+	else
+		aabb_list_entries = entries;
+}
+
+void VulkanRenderer::GetCullState(ClusteCullState* state)
+{
+	memset(state, 0, sizeof(ClusteCullState));
+	state->camera = camera;
+	state->viewVersion = camera->GetViewVersion();
+	state->projectVersion = camera->GetProjectVersion();
+	state->screenSize = glm::uvec2(Application::Inst()->GetWidth(), Application::Inst()->GetHeight());
+	state->isCpuClusteCull = isCpuClusteCull ? 1 : 0;
+	state->isIspc = isIspc ? 1 : 0;
+	state->isSimdCull = isSimdCull ? 1 : 0;
+	state->isMultiThreadCull = isMultiThreadCull ? 1 : 0;
+	state->isExactCull = isExactCull ? 1 : 0;
+	state->simdLevel = simdLevel;
+	state->cpuCullMethod = cpuCullMethod;
+	state->clusteListFormat = clusteListFormat;
+	state->isDedupLists = isDedupLists ? 1 : 0;
+	state->isUploadLists = isUploadLists ? 1 : 0;
+}
+
+ClusteCullReuse VulkanRenderer::CheckCullReuse(bool canUpdate)
+{
+	ClusteCullState state;
+	GetCullState(&state);
+	ClusteCullState lastState = cull_state;
+	lastState.viewVersion = state.viewVersion;
+	isCullSetupChanged = !is_cull_state_valid || memcmp(&state, &lastState, sizeof(ClusteCullState)) != 0;
+	bool isSameState = isTemporalReuse && !isCullSetupChanged && state.viewVersion == cull_state.viewVersion;
+	cull_state = state;
+	is_cull_state_valid = true;
+
+	if (!isSameState)
+		return CullReuse_Full;
+	if (cull_light_version == light_store->GetVersion())
+		return CullReuse_Skipped;
+
+	/// the gpu culling is one dispatch and starts over, so do the cpu layouts the update does not know
+	if (!isCpuClusteCull || !canUpdate || changed_lights_end - changed_lights_begin > TEMPORAL_REUSE_MAX_CHANGED)
+		return CullReuse_Full;
+	return CullReuse_Partial;
+}
+
+void VulkanRenderer::CullAmortized(bool isBitmask, glm::vec4* tilePlanes, LightGrid* lightGrids, glm::uint* lightIndexes)
+{
+	VolumeTileAABB* clusteAABBs = (VolumeTileAABB*)tile_aabbs_buffer_data;
+	glm::vec4* viewLights = (glm::vec4*)light_views_buffer_data;
+	int lightCount = light_store->GetCount();
+	int sliceGroups = std::min((int)amortizedSliceGroups, (int)group_num.z);
+
+	/// new or removed lights shift slots, that and a new grid or mode leave nothing to keep
+	bool isRefreshAll = isCullSetupChanged || sliceGroups != amortized_slice_groups || (int)amortized_prev_lights.size() != lightCount;
+	if ((int)amortized_prev_lights.size() != lightCount)
+	{
+		amortized_prev_lights.assign(viewLights, viewLights + lightCount);
+		amortized_light_motion.assign(lightCount, 0.0f);
+	}
+	amortized_view_lights.resize(lightCount);
+	if (!RawCpu::inflate_view_lights(lightCount, viewLights, amortized_prev_lights.data(), amortized_light_motion.data(), sliceGroups - 1, amortized_view_lights.data()))
+	{
+		isRefreshAll = true;
+	}
+
+	int groups = isRefreshAll ? 1 : sliceGroups;
+	int group = isRefreshAll ? 0 : amortized_slice_group % sliceGroups;
+	ThreadPool* threadPool = isMultiThreadCull ? cull_thread_pool : NULL;
+	if (isBitmask)
+		RawCpu::cluste_culling_bitmask_amortized(threadPool, group_num.x, group_num.y, group_num.z, groups, group, clusteAABBs, tilePlanes, amortized_view_lights.data(), lightCount,
+			light_mask_words, (uint32_t*)light_indexes_buffer_data);
+	else
+		RawCpu::cluste_culling_amortized(threadPool, group_num.x, group_num.y, group_num.z, groups, group, clusteAABBs, tilePlanes, amortized_view_lights.data(), lightCount,
+			light_index_capacity, lightGrids, lightIndexes);
+
+	amortized_prev_lights.assign(viewLights, viewLights + lightCount);
+	amortized_slice_groups = sliceGroups;
+	amortized_slice_group = (amortized_slice_group + 1) % sliceGroups;
+}
+
+const std::vector<double>& VulkanRenderer::GetIspcTaskTimes()
+{
+	return IspcTasks::GetTaskTimes();
+}
+
+void VulkanRenderer::UpdateClusteAABBs()
+{
+	glm::uvec2 screenSize = glm::uvec2(Application::Inst()->GetWidth(), Application::Inst()->GetHeight());
+	if (tile_aabbs_camera == camera && tile_aabbs_project_version == camera->GetProjectVersion() && tile_aabbs_screen_size == screenSize)
+	{
+		return;
+	}
+
+	/// any dispatch in flight may still read the aabbs, they change rarely enough to wait for all
+	WaitCompute(comp_timeline_value);
+
+	ScreenToView screenToView;
+	SetScreenToViewData(&screenToView);
+	screenToView.screenDimensions = screenSize;
+	screenToView.tileSizes = glm::uvec4(group_num, tile_size_x);
+	RawCpu::build_cluste_aabbs(group_num.x, group_num.y, group_num.z, screenToView, (VolumeTileAABB*)tile_aabbs_buffer_data);
+	tile_planes.resize(group_num.x * group_num.y * 4);
+	RawCpu::build_tile_planes(group_num.x, group_num.y, screenToView, tile_planes.data());
+
+	tile_aabbs_camera = camera;
+	tile_aabbs_project_version = camera->GetProjectVersion();
+	tile_aabbs_screen_size = screenSize;
+}
+
+void VulkanRenderer::UpdateViewLights()
+{
+	/// move on to a copy the dispatches in flight do not read, the last one stays intact for the partial reuse
+	view_light_slot = (view_light_slot + 1) % MAX_FRAMES_IN_FLIGHT;
+	WaitCompute(view_light_values[view_light_slot]);
+	light_views_buffer_data = light_views_slot_data[view_light_slot];
+
+	ScreenToView screenToView;
+	SetScreenToViewData(&screenToView);
+	glm::vec4* viewLights = (glm::vec4*)light_views_buffer_data;
+	RawCpu::transform_lights(screenToView, light_store->GetCount(), light_store->GetPosX(), light_store->GetPosY(), light_store->GetPosZ(), light_store->GetRadius(), light_store->GetEnabledBits(), viewLights);
+
+	/// the compute shader takes the light count from the buffer range, an empty range is not allowed
+	if (light_store->GetCount() == 0)
+	{
+		viewLights[0] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+	}
+	light_views_buffer_info[view_light_slot].range = sizeof(glm::vec4) * std::max(light_store->GetCount(), 1);
+}
+
 void VulkanRenderer::ClearLightBufferData()
 {
-	memset(light_grids_buffer_data, 0, sizeof(LightGrid) * CLUSTE_NUM);
-	memset(light_indexes_buffer_data, 0, sizeof(glm::uint) * MAX_LIGHT_NUM * CLUSTE_NUM);
+	/// the frames in flight may still read any slot, each one is cleared when it is picked for writing
+	light_slots_to_clear = MAX_FRAMES_IN_FLIGHT;
+	is_cull_state_valid = false;
+}
+
+void VulkanRenderer::SelectLightListSlot(int slot)
+{
+	/// the frame fences already cover the lists, the screen to view and counters of the slot need the dispatch itself done
+	WaitCompute(light_list_values[slot]);
+	light_list_slot = slot;
+	light_grids_buffer_data = light_grids_slot_data[slot];
+	light_indexes_buffer_data = light_indexes_slot_data[slot];
+	screen_to_view_buffer_data = screen_to_view_slot_data[slot];
+	if (light_slots_to_clear > 0)
+	{
+		memset(light_grids_buffer_data, 0, (size_t)local_light_grids_buffer_info[slot].range);
+		memset(light_indexes_buffer_data, 0, (size_t)local_light_indexes_buffer_info[slot].range);
+		light_slots_to_clear--;
+	}
+}
+
+void VulkanRenderer::WaitCompute(uint64_t value)
+{
+	/// most waits are for dispatches finished long ago, the counter tells without blocking
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(device, comp_timeline_semaphore, &completed);
+	if (completed >= value)
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &comp_timeline_semaphore;
+	waitInfo.pValues = &value;
+	vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max());
+}
+
+void VulkanRenderer::PollComputeCounts()
+{
+	if (comp_counts_value == comp_timeline_value)
+	{
+		return;
+	}
+
+	/// the totals of the newest finished dispatch, a frame or two behind but never waited for
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(device, comp_timeline_semaphore, &completed);
+	int newestSlot = -1;
+	for (int slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++)
+	{
+		if (light_list_values[slot] > comp_counts_value && light_list_values[slot] <= completed && (newestSlot < 0 || light_list_values[slot] > light_list_values[newestSlot]))
+			newestSlot = slot;
+	}
+	if (newestSlot < 0)
+	{
+		return;
+	}
+
+	glm::uint* indexCounts = (glm::uint*)index_count_slot_data[newestSlot];
+	UpdateLightListEntries(indexCounts[0]);
+	light_list_overflows = indexCounts[1];
+	comp_counts_value = light_list_values[newestSlot];
+}
+
+void VulkanRenderer::SelectFrame(uint32_t frame)
+{
+	/// the transform block is only partly rewritten every frame, the rest carries over
+	if (frame != frame_index)
+	{
+		memcpy(transform_uniform_slot_data[frame], transform_uniform_buffer_data, sizeof(TransformData));
+	}
+	frame_index = frame;
+	transform_uniform_buffer_data = transform_uniform_slot_data[frame];
+	light_datas_buffer_data = light_datas_slot_data[frame];
+}
+
+void VulkanRenderer::CullCpu(bool isBitmask, bool isZBinning, bool isAmortized, bool isCompact, bool isDedup, int changedBegin, int changedEnd, int carrySlot)
+{
+	/// the temporal update and the amortized culling patch the lists of the last cull, which went to the slot before
+	if (carrySlot >= 0)
+	{
+		memcpy(light_grids_buffer_data, light_grids_slot_data[carrySlot], (size_t)local_light_grids_buffer_info[carrySlot].range);
+		memcpy(light_indexes_buffer_data, light_indexes_slot_data[carrySlot], (size_t)local_light_indexes_buffer_info[carrySlot].range);
+	}
+
+	VolumeTileAABB* clusteAABBs = (VolumeTileAABB*)tile_aabbs_buffer_data;
+	glm::vec4* viewLights = (glm::vec4*)light_views_buffer_data;
+	glm::vec4* tilePlanes = isExactCull ? tile_planes.data() : NULL;
+
+	/// compact and deduplicated lists are built from 32 bit lists kept on the cpu side, every backend writes those.
+	/// the temporal update and the amortized culling patch them in place across frames
+	LightGrid* lightGrids = (LightGrid*)light_grids_buffer_data;
+	glm::uint* lightIndexes = (glm::uint*)light_indexes_buffer_data;
+	if (isCompact || isDedup)
+	{
+		cull_light_grids.resize(cluste_num);
+		cull_light_indexes.resize(light_index_capacity * cluste_num);
+		lightGrids = cull_light_grids.data();
+		lightIndexes = cull_light_indexes.data();
+	}
+	IspcTasks::ResetTaskTimes();
+	Utils::GetMSStart();
+	if (cullReuse == CullReuse_Partial)
+	{
+		/// every backend gives the lists of cluste_culling, so the update patches whichever ran last
+		if (isBitmask)
+			RawCpu::cluste_culling_bitmask_update(group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(),
+				changedBegin, changedEnd, light_mask_words, (uint32_t*)light_indexes_buffer_data);
+		else
+			RawCpu::cluste_culling_update(group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(),
+				changedBegin, changedEnd, changed_view_lights.data(), lightGrids, lightIndexes, reuse_index_list);
+	}
+	else if (isAmortized)
+	{
+		/// stale slices keep their lists, inflated radii keep them conservative
+		CullAmortized(isBitmask, tilePlanes, lightGrids, lightIndexes);
+	}
+	else if (isZBinning)
+	{
+		/// light grids hold the z bins, the index buffer the tile masks followed by the sorted light map
+		ScreenToView screenToView;
+		SetScreenToViewData(&screenToView);
+		glm::uint* tileMasks = (glm::uint*)light_indexes_buffer_data;
+		glm::uint* sortedLights = tileMasks + group_num.x * group_num.y * light_mask_words;
+		RawCpu::cluste_culling_zbin(isMultiThreadCull ? cull_thread_pool : NULL, group_num.x, group_num.y, group_num.z, screenToView, tile_planes.data(), viewLights, light_store->GetCount(),
+			light_mask_words, (glm::uvec2*)light_grids_buffer_data, tileMasks, sortedLights);
+	}
+	else if (isBitmask)
+	{
+		/// clustes are independent, both cull methods end up in the cluste-major kernel
+#ifdef CLUSTE_USE_ISPC
+		if (isIspc)
+			ispc::cluste_culling_bitmask_ispc(group_num.x, group_num.y, group_num.z, clusteAABBs, (ispc::float4*)tilePlanes, (ispc::float4*)viewLights, light_store->GetCount(), light_mask_words, (uint32_t*)light_indexes_buffer_data);
+		else
+#endif
+			RawCpu::cluste_culling_bitmask(isMultiThreadCull ? cull_thread_pool : NULL, group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(), light_mask_words, (uint32_t*)light_indexes_buffer_data);
+	}
+	else if (isSimdCull && simdLevel != SimdCpu::SimdLevel_None)
+	{
+		/// calculation with the intrinsics backend picked by cpuid
+		SimdCpu::SoaLights soaLights;
+		SimdCpu::BuildSoaLights(viewLights, light_store->GetCount(), simd_light_storage, soaLights);
+		RawCpu::cluste_culling_simd(isMultiThreadCull ? cull_thread_pool : NULL, group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, soaLights, SimdCpu::GetClusteLights(simdLevel),
+			lightGrids, lightIndexes);
+	}
+	else if (!isIspc)
+	{
+		/// calculation with raw cpu for debug and compare
+		if (cpuCullMethod == CpuCull_LightMajor)
+		{
+			ScreenToView screenToView;
+			SetScreenToViewData(&screenToView);
+			RawCpu::cluste_culling_light_major(group_num.x, group_num.y, group_num.z, screenToView, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(), lightGrids, lightIndexes);
+		}
+		else if (cpuCullMethod == CpuCull_LightBVH)
+		{
+			light_bvh->Build(viewLights, light_store->GetCount());
+			RawCpu::cluste_culling_bvh(isMultiThreadCull ? cull_thread_pool : NULL, group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, *light_bvh, viewLights, lightGrids, lightIndexes);
+		}
+		else if (cpuCullMethod == CpuCull_SuperCluste)
+		{
+			glm::ivec3 superSize = glm::ivec3(SUPER_CLUSTE_X, SUPER_CLUSTE_Y, SUPER_CLUSTE_Z);
+			RawCpu::cluste_culling_super(isMultiThreadCull ? cull_thread_pool : NULL, group_num.x, group_num.y, group_num.z, superSize, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(), lightGrids, lightIndexes);
+		}
+		else if (!isMultiThreadCull)
+			RawCpu::cluste_culling(group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(), lightGrids, lightIndexes);
+		else
+			RawCpu::cluste_culling_parallel(cull_thread_pool, group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, viewLights, light_store->GetCount(), lightGrids, lightIndexes);
+	}
+#ifdef CLUSTE_USE_ISPC
+	else if (!isMultiThreadCull)
+	{
+		/// calculation with ispc
+		ispc::cluste_culling_ispc(group_num.x, group_num.y, group_num.z, clusteAABBs, (ispc::float4*)tilePlanes, (ispc::float4*)viewLights, light_store->GetCount(), lightGrids, lightIndexes);
+	}
+	else
+	{
+		/// ispc tasks on the cull thread pool, scratch sizes follow cluste_culling_tasks_ispc
+		int lightCount = light_store->GetCount();
+		int taskNum = std::min((int)(cull_thread_pool->GetConcurrency() * ISPC_TASKS_PER_THREAD), (int)cluste_num);
+		int clustesPerTask = ((int)cluste_num + taskNum - 1) / taskNum;
+		ispc_task_lists.resize((size_t)taskNum * clustesPerTask * std::min(lightCount, MAX_LIGHTS_PER_CLUSTE));
+		ispc_task_offsets.resize(taskNum + 1);
+		ispc::cluste_culling_tasks_ispc(taskNum, group_num.x, group_num.y, group_num.z, clusteAABBs, (ispc::float4*)tilePlanes, (ispc::float4*)viewLights, lightCount, lightGrids, lightIndexes,
+			ispc_task_lists.data(), ispc_task_offsets.data());
+	}
+#endif
+	glm::uint sharedEntries = 0;
+	if (isDedup)
+	{
+		/// compact lists are packed from the shared runs, index lists take them as they are
+		LightGrid* sharedGrids = (LightGrid*)light_grids_buffer_data;
+		glm::uint* sharedIndexes = (glm::uint*)light_indexes_buffer_data;
+		if (isCompact)
+		{
+			dedup_light_grids.resize(cluste_num);
+			dedup_light_indexes.resize(light_index_capacity * cluste_num);
+			sharedGrids = dedup_light_grids.data();
+			sharedIndexes = dedup_light_indexes.data();
+		}
+		sharedEntries = RawCpu::dedup_light_lists(cluste_num, lightGrids, lightIndexes, sharedGrids, sharedIndexes, dedup_table);
+		if (isCompact)
+		{
+			RawCpu::pack_compact_lists(cluste_num, sharedGrids, sharedIndexes, (glm::uint*)light_grids_buffer_data, (uint16_t*)light_indexes_buffer_data, sharedEntries);
+		}
+	}
+	else if (isCompact)
+	{
+		RawCpu::pack_compact_lists(cluste_num, lightGrids, lightIndexes, (glm::uint*)light_grids_buffer_data, (uint16_t*)light_indexes_buffer_data);
+	}
+	cpuCullTime = Utils::GetMSEnd();
+
+	/// z-binning keeps no per cluste lists and bitmasks are never clamped
+	light_list_overflows = 0;
+	list_dedup_ratio = 1.0f;
+	if (isBitmask)
+		UpdateLightListEntries(RawCpu::count_mask_entries(cluste_num, light_mask_words, (glm::uint*)light_indexes_buffer_data));
+	else if (!isZBinning)
+	{
+		glm::uint entries = RawCpu::count_list_entries(cluste_num, lightGrids);
+		UpdateLightListEntries(entries);
+		if (isDedup && sharedEntries > 0)
+			list_dedup_ratio = (float)entries / sharedEntries;
+		if (isOverflowCheck)
+			light_list_overflows = RawCpu::count_list_overflows(group_num.x, group_num.y, group_num.z, clusteAABBs, tilePlanes, isAmortized ? amortized_view_lights.data() : viewLights, light_store->GetCount(),
+				lightGrids, lightIndexes);
+	}
+
+	/// the bytes of the slot the shading reads, the upload copies no more
+	if (isZBinning)
+	{
+		light_grids_dirty_bytes = sizeof(glm::uvec2) * group_num.z;
+		light_indexes_dirty_bytes = sizeof(glm::uint) * (group_num.x * group_num.y * light_mask_words + light_store->GetCount());
+	}
+	else if (isBitmask)
+	{
+		light_grids_dirty_bytes = 0;
+		light_indexes_dirty_bytes = sizeof(glm::uint) * light_mask_words * cluste_num;
+	}
+	else if (isCompact)
+	{
+		glm::uint packedEntries = isDedup ? sharedEntries : RawCpu::count_list_entries(cluste_num, lightGrids);
+		light_grids_dirty_bytes = sizeof(glm::uint) * cluste_num;
+		light_indexes_dirty_bytes = sizeof(uint16_t) * ((packedEntries + 1) & ~1u);
+	}
+	else
+	{
+		light_grids_dirty_bytes = sizeof(LightGrid) * cluste_num;
+		light_indexes_dirty_bytes = sizeof(glm::uint) * (isDedup ? sharedEntries : RawCpu::count_list_extent(cluste_num, lightGrids));
+	}
+}
+
+void VulkanRenderer::RecordListUpload(VkCommandBuffer commandBuffer)
+{
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording upload command buffer!");
+	}
+
+	/// no frame in flight reads the slot, the copy only has to land before this frame's shading
+	VkBufferCopy copyRegion = {};
+	if (light_grids_dirty_bytes > 0)
+	{
+		copyRegion.size = light_grids_dirty_bytes;
+		vkCmdCopyBuffer(commandBuffer, local_light_grids_buffer[light_list_slot], gpu_light_grids_buffer[light_list_slot], 1, &copyRegion);
+	}
+	if (light_indexes_dirty_bytes > 0)
+	{
+		copyRegion.size = light_indexes_dirty_bytes;
+		vkCmdCopyBuffer(commandBuffer, local_light_indexes_buffer[light_list_slot], gpu_light_indexes_buffer[light_list_slot], 1, &copyRegion);
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+}
+
+void VulkanRenderer::JoinCull()
+{
+	if (!cull_job.valid())
+	{
+		cullWaitTime = 0.0;
+		return;
+	}
+
+	/// the job times itself with Utils, this clock is kept apart
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	cull_job.get();
+	cullWaitTime = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1000.0;
 }
 
 void VulkanRenderer::RenderBegin()
@@ -1984,45 +2628,89 @@ void VulkanRenderer::RenderBegin()
 	assert(camera != NULL);
 	camera->UpdateViewProject();
 
+	UploadLights();
+
+	/// the gpu culling always writes index lists, z-binning has its own layout
+	bool isZBinning = isClusteShading && isCpuClusteCull && !isIspc && !isSimdCull && cpuCullMethod == CpuCull_ZBinning;
+	bool isBitmask = isClusteShading && isCpuClusteCull && !isZBinning && clusteListFormat == ClusteList_Bitmask;
+	bool isAmortized = isClusteShading && isCpuClusteCull && !isIspc && cpuCullMethod == CpuCull_Amortized && (isBitmask || !isSimdCull || simdLevel == SimdCpu::SimdLevel_None);
+	bool isCompact = isClusteShading && !isZBinning && clusteListFormat == ClusteList_Compact && light_capacity <= COMPACT_LIST_MAX_LIGHTS
+		&& (unsigned long long)cluste_num * MAX_LIGHTS_PER_CLUSTE < COMPACT_LIST_MAX_ENTRIES;
+	bool isDedup = isClusteShading && isCpuClusteCull && !isZBinning && !isBitmask && isDedupLists;
+	TransformData* transData = (TransformData*)transform_uniform_buffer_data;
+	transData->lightMaskWords = (isBitmask || isZBinning) ? light_mask_words : 0;
+	transData->isZBinning = isZBinning ? 1 : 0;
+	transData->isCompactList = isCompact ? 1 : 0;
+
 	/// branch ispc/gpu cluste_shading
+	isCompDispatched = false;
+	isListUploadPending = false;
 	if (isClusteShading)
 	{
-		if (isCpuClusteCull)
+		UpdateClusteAABBs();
+		cullReuse = CheckCullReuse(!isZBinning && !isAmortized);
+		if (cullReuse == CullReuse_Partial)
 		{
-			/// update input data
-			ScreenToView screenToView;
-			SetScreenToViewData(&screenToView);
-			screenToView.screenDimensions = glm::uvec2(Application::Inst()->GetWidth(), Application::Inst()->GetHeight());
-			screenToView.tileSizes = glm::uvec4(group_num, tile_size_x);
+			/// the view lights still hold the spheres of the last cull until UpdateViewLights
+			glm::vec4* viewLights = (glm::vec4*)light_views_buffer_data;
+			changed_view_lights.resize(changed_lights_end - changed_lights_begin);
+			for (int light = changed_lights_begin; light < changed_lights_end; light++)
+			{
+				changed_view_lights[light - changed_lights_begin] = light < cull_light_count ? viewLights[light] : glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+			}
+		}
+		if (cullReuse != CullReuse_Skipped)
+		{
+			UpdateViewLights();
+		}
 
-			PointLightData* lightDatas = light_infos.data();
-			Utils::GetMSStart();
-			if (!isIspc)
+		if (cullReuse == CullReuse_Skipped)
+		{
+			cpuCullTime = 0.0;
+		}
+		else if (isCpuClusteCull)
+		{
+			/// the changed range restarts below, the job takes it by value
+			int changedBegin = changed_lights_begin;
+			int changedEnd = changed_lights_end;
+
+			/// move on to the slot of the oldest frame, its fence was waited in Flush. lists patched in place
+			/// are carried over unless they live on the cpu side, where compact and deduplicated lists are built from
+			int carrySlot = -1;
+			if ((cullReuse == CullReuse_Partial || isAmortized) && (isBitmask || !(isCompact || isDedup)))
+				carrySlot = light_list_slot;
+			SelectLightListSlot((light_list_slot + 1) % MAX_FRAMES_IN_FLIGHT);
+			isListUploadPending = isUploadLists;
+
+			if (isAsyncCull)
 			{
-				/// calculation with raw cpu for debug and compare
-				RawCpu::cluste_culling(CLUSTE_X, CLUSTE_Y, CLUSTE_Z, screenToView, light_infos.data(), light_infos.size(), (LightGrid*)light_grids_buffer_data, (uint32_t*)light_indexes_buffer_data);
+				/// joined in Flush before the submit, the lists are only read by the gpu
+				cull_job = cull_job_thread->Submit([=]()
+				{
+					CullCpu(isBitmask, isZBinning, isAmortized, isCompact, isDedup, changedBegin, changedEnd, carrySlot);
+				});
 			}
 			else
 			{
-				/// calculation with ispc
-				ispc::ScreenToViewISPC screenToViewIspc;
-				memcpy(&screenToViewIspc.inverseProjection, &screenToView.inverseProjection, sizeof(glm::mat4));
-				///screenToView.viewMatrix = glm::transpose(screenToView.viewMatrix);
-				memcpy(&screenToViewIspc.viewMatrix, &screenToView.viewMatrix, sizeof(glm::mat4));
-				memcpy(&screenToViewIspc.tileSizes, &screenToView.tileSizes, sizeof(glm::uvec4));
-				memcpy(&screenToViewIspc.screenDimensions, &screenToView.screenDimensions, sizeof(glm::uvec2));
-				screenToViewIspc.zFar = screenToView.zFar;
-				screenToViewIspc.zNear = screenToView.zNear;
-				ispc::cluste_culling_ispc(CLUSTE_X, CLUSTE_Y, CLUSTE_Z, screenToViewIspc, pointLightISPCDatas, light_infos.size(), (LightGrid*)light_grids_buffer_data, (uint32_t*)light_indexes_buffer_data);
+				CullCpu(isBitmask, isZBinning, isAmortized, isCompact, isDedup, changedBegin, changedEnd, carrySlot);
 			}
-			cpuCullTime = Utils::GetMSEnd();
 		}
 		else
 		{
 			SetScreenToViewData((ScreenToView*)screen_to_view_buffer_data);
+			((ScreenToView*)screen_to_view_buffer_data)->isExactCull = isExactCull ? 1 : 0;
+			((ScreenToView*)screen_to_view_buffer_data)->isCompactList = isCompact ? 1 : 0;
+			SelectLightListSlot((light_list_slot + 1) % MAX_FRAMES_IN_FLIGHT);
 			UpdateComputeDescriptorSet();
+			isCompDispatched = true;
 			cpuCullTime = 0.0;
+			list_dedup_ratio = 1.0f;
 		}
+
+		cull_light_version = light_store->GetVersion();
+		cull_light_count = light_store->GetCount();
+		changed_lights_begin = INT_MAX;
+		changed_lights_end = 0;
 	}
 
 	VkCommandBufferBeginInfo beginInfo = {};
@@ -2032,7 +2720,8 @@ void VulkanRenderer::RenderBegin()
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
-	if (isClusteShading && !isCpuClusteCull)
+	/// a skipped dispatch released nothing, the graphics queue still owns the lists of the last one
+	if (isCompDispatched)
 	{
 		QueueFamilyIndices indices = FindQueueFamilies(physical_device);
 		VkBufferMemoryBarrier buffer_barriers[2] =
@@ -2044,9 +2733,9 @@ void VulkanRenderer::RenderBegin()
 				VK_ACCESS_SHADER_READ_BIT,
 				indices.computeFamily.value(),
 				indices.graphicsFamily.value(),
-				gpu_light_indexes_buffer_info.buffer,
+				gpu_light_indexes_buffer_info[light_list_slot].buffer,
 				0,
-				gpu_light_indexes_buffer_info.range,
+				gpu_light_indexes_buffer_info[light_list_slot].range,
 			},
 			{
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -2055,9 +2744,9 @@ void VulkanRenderer::RenderBegin()
 				VK_ACCESS_SHADER_READ_BIT,
 				indices.computeFamily.value(),
 				indices.graphicsFamily.value(),
-				gpu_light_grids_buffer_info.buffer,
+				gpu_light_grids_buffer_info[light_list_slot].buffer,
 				0,
-				gpu_light_grids_buffer_info.range,
+				gpu_light_grids_buffer_info[light_list_slot].range,
 			},
 		};
 
@@ -2103,10 +2792,7 @@ void VulkanRenderer::Flush()
 {
 	if (last_command_buffer_idx != UINT_MAX)
 	{
-		vkWaitForFences(device, 1, &in_flight_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-		vkResetFences(device, 1, &in_flight_fence);
-	
-		VkSemaphore waitSemaphores[] = { render_finished_semaphore };
+		VkSemaphore waitSemaphores[] = { render_finished_semaphores[last_frame_index] };
 		
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -2123,32 +2809,68 @@ void VulkanRenderer::Flush()
 		}
 	}
 
-	vkAcquireNextImageKHR(device, swap_chain, std::numeric_limits<uint64_t>::max(), image_available_semaphore, VK_NULL_HANDLE, &active_command_buffer_idx);
+	vkAcquireNextImageKHR(device, swap_chain, std::numeric_limits<uint64_t>::max(), image_available_semaphores[frame_index], VK_NULL_HANDLE, &active_command_buffer_idx);
+
+	/// command buffers and descriptor sets are per swap chain image, an older frame may still use them
+	if (images_in_flight[active_command_buffer_idx] != VK_NULL_HANDLE && images_in_flight[active_command_buffer_idx] != in_flight_fences[frame_index])
+	{
+		vkWaitForFences(device, 1, &images_in_flight[active_command_buffer_idx], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	images_in_flight[active_command_buffer_idx] = in_flight_fences[frame_index];
 
 	Application::Inst()->SceneRender();
 
-	VkSemaphore signalSemaphores[] = { render_finished_semaphore };
+	/// the cpu culling ran while the frame was recorded
+	JoinCull();
+
+	/// the upload knows the dirty ranges only now, it goes ahead of the frame in the same submit
+	VkCommandBuffer commandBuffers[2] = { command_buffers[active_command_buffer_idx], VK_NULL_HANDLE };
+	uint32_t commandBufferCount = 1;
+	if (isListUploadPending)
+	{
+		RecordListUpload(upload_command_buffers[active_command_buffer_idx]);
+		commandBuffers[0] = upload_command_buffers[active_command_buffer_idx];
+		commandBuffers[1] = command_buffers[active_command_buffer_idx];
+		commandBufferCount = 2;
+	}
+
+	VkSemaphore signalSemaphores[] = { render_finished_semaphores[frame_index] };
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkSemaphore waitSemaphores[2] = { image_available_semaphore, compute_finished_semaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };	/// in the stage wait the sema
-	if(isClusteShading && !isCpuClusteCull)
+	VkSemaphore waitSemaphores[2] = { image_available_semaphores[frame_index], comp_timeline_semaphore };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };	/// in the stage wait the sema
+	if (isCompDispatched)
 		submitInfo.waitSemaphoreCount = 2;
 	else
 		submitInfo.waitSemaphoreCount = 1;
+	/// the frame's dispatch was the last one submitted, the binary semaphore ignores its value
+	uint64_t waitValues[2] = { 0, comp_timeline_value };
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	submitInfo.pNext = &timelineInfo;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &command_buffers[active_command_buffer_idx];
+	submitInfo.commandBufferCount = commandBufferCount;
+	submitInfo.pCommandBuffers = commandBuffers;
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
+	vkResetFences(device, 1, &in_flight_fences[frame_index]);
+
 	VkResult ret;
-	if ((ret = vkQueueSubmit(graphics_queue, 1, &submitInfo, in_flight_fence)) != VK_SUCCESS) {
+	if ((ret = vkQueueSubmit(graphics_queue, 1, &submitInfo, in_flight_fences[frame_index])) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
 
 	last_command_buffer_idx = active_command_buffer_idx;
+	last_frame_index = frame_index;
+
+	/// the next frame's buffers are written from the scene update on, wait until the gpu let go of them
+	uint32_t nextFrame = (frame_index + 1) % framesInFlight;
+	vkWaitForFences(device, 1, &in_flight_fences[nextFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	SelectFrame(nextFrame);
 }
 
 void VulkanRenderer::WaitIdle()
@@ -2159,4 +2881,5 @@ void VulkanRenderer::WaitIdle()
 void VulkanRenderer::OnSceneExit()
 {
 	ClearLight();
+	tile_aabbs_camera = NULL;
 }
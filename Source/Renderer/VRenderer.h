@@ -1,10 +1,13 @@
 ﻿#ifndef __VULKAN_RENDERER_H__
 #define	__VULKAN_RENDERER_H__
 
+#include <cstddef>
 #include <vector>
 #include <set>
 #include <array>
 #include <optional>
+#include <algorithm>
+#include <future>
 
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_EXPOSE_NATIVE_WIN32
@@ -12,12 +15,26 @@
 #include <GLFW/glfw3native.h>
 
 #include "Renderer.h"
-
-#define MAX_LIGHT_NUM 16
-#define CLUSTE_X 16
-#define CLUSTE_Y 9
-#define CLUSTE_Z 24
-#define CLUSTE_NUM (CLUSTE_X * CLUSTE_Y * CLUSTE_Z)
+#include "LightStore.h"
+#include "ClusteCullingSimd.h"
+
+#define INIT_LIGHT_CAPACITY 16
+#define MAX_FRAMES_IN_FLIGHT 3	/// per frame resources are allocated for this many, also the slots of the light list rings
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+#define MAX_LIGHTS_PER_CLUSTE 100	/// longer cluste light lists are clamped and counted as overflows
+#define LIGHT_GRID_COUNT_BITS 8	/// compact light grids, offset << 8 | count in one word
+#define COMPACT_LIST_MAX_LIGHTS 65536	/// compact light indexes are 16 bit, more lights fall back to 32 bit lists
+#define COMPACT_LIST_MAX_ENTRIES (1u << (32 - LIGHT_GRID_COUNT_BITS))	/// compact offsets keep the bits above the count, larger grids fall back to 32 bit lists
+#define DEFAULT_CLUSTE_TILE_SIZE 80	/// pixels, tiles are square
+#define DEFAULT_CLUSTE_Z 24
+#define CLUSTE_CULL_GROUP_SIZE 128	/// local_size_x of cluste_culling.comp, passed as its specialization constant
+#define SUPER_CLUSTE_X 4	/// clustes per super cluste for CpuCull_SuperCluste
+#define SUPER_CLUSTE_Y 3
+#define SUPER_CLUSTE_Z 4
+#define ISPC_TASKS_PER_THREAD 4	/// more tasks than threads so the pool can balance them
+#define TEMPORAL_REUSE_MAX_CHANGED 16	/// more changed light slots than this are culled from scratch
+#define AMORTIZED_SLICE_GROUPS 4	/// CpuCull_Amortized culls every 4th z slice per frame
+#define AMORTIZED_MOTION_SLACK 1.25f	/// recorded light motion is scaled up by this
 
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
@@ -59,6 +76,10 @@ struct TransformData {
 	float zFar;
 	float scale;
 	float bias;
+	glm::uint lightCount;
+	glm::uint lightMaskWords;	/// 0: offset/count light lists, else words per cluste bitmask
+	glm::uint isZBinning;	/// masks are per screen tile, light grids hold the z bins
+	glm::uint isCompactList;	/// 16 bit light indexes, one packed word per light grid
 };
 
 /// material flag for shader
@@ -97,7 +118,12 @@ struct ScreenToView
 	glm::uvec2 screenDimensions;
 	float zNear;
 	float zFar;
+	glm::uint isExactCull;	/// only read by cluste_culling.comp
+	glm::uint isCompactList;
 };
+/// binding 1 of cluste_culling.comp is std430, a field moved here has to move there too
+static_assert(offsetof(ScreenToView, tileSizes) == 128 && offsetof(ScreenToView, screenDimensions) == 144, "ScreenToView does not match cluste_culling.comp");
+static_assert(offsetof(ScreenToView, isExactCull) == 160 && offsetof(ScreenToView, isCompactList) == 164, "ScreenToView does not match cluste_culling.comp");
 
 /// light grid
 struct LightGrid {
@@ -105,9 +131,53 @@ struct LightGrid {
 	glm::uint count;
 };
 
+/// raw cpu culling algorithm
+enum CpuCullMethod {
+	CpuCull_ClusteMajor,	/// every cluste tests every light
+	CpuCull_LightMajor,		/// every light visits the clustes it covers
+	CpuCull_ZBinning,		/// depth sorted lights, z bin ranges and screen tile masks
+	CpuCull_LightBVH,		/// every cluste queries a bvh over the light spheres
+	CpuCull_SuperCluste,	/// lights are tested against blocks of clustes first
+	CpuCull_Amortized,		/// 1 / N of the z slices per frame, with radii inflated by the light motion
+};
+
+/// cpu/ispc culling output
+enum ClusteListFormat {
+	ClusteList_Indexes,		/// LightGrid offset/count into one global index list
+	ClusteList_Bitmask,		/// one bit per light, fixed words per cluste
+	ClusteList_Compact,		/// ClusteList_Indexes packed to 16 bit indexes and one word per grid
+};
+
+/// how the light lists of the last frame were produced
+enum ClusteCullReuse {
+	CullReuse_Full,		/// culled from scratch
+	CullReuse_Partial,	/// only the clustes of the changed lights were culled again
+	CullReuse_Skipped,	/// camera and lights unchanged, the lists of the frame before were kept
+};
+
+/// everything the light lists depend on besides the lights, compared with memcmp so it is cleared before it is filled
+struct ClusteCullState {
+	Camera* camera;
+	unsigned int viewVersion;
+	unsigned int projectVersion;
+	glm::uvec2 screenSize;
+	glm::uint isCpuClusteCull;
+	glm::uint isIspc;
+	glm::uint isSimdCull;
+	glm::uint isMultiThreadCull;
+	glm::uint isExactCull;
+	int simdLevel;
+	int cpuCullMethod;
+	int clusteListFormat;
+	glm::uint isDedupLists;
+	glm::uint isUploadLists;
+};
+
 class Texture;
 class Material;
 class PointLight;
+class ThreadPool;
+class LightBVH;
 class VulkanRenderer : public Renderer
 {
 	const int MAX_MATERIAL_NUM = 50;
@@ -160,22 +230,98 @@ public:
 	void CreateTextureSampler(VkSampler* sampler);
 	void DestroyTextureSampler(VkSampler* sampler);
 
-	void AddLight(PointLight* light);
+	LightHandle AddLight(PointLight* light);
+	void UpdateLight(LightHandle handle, PointLight* light);
+	void RemoveLight(LightHandle handle);
 	void ClearLight();
+	void ReserveLights(unsigned int lightNum);
+	unsigned int GetLightCapacity() { return light_capacity; }
 
 	void UpdateComputeDescriptorSet();
 
 	bool IsClusteShading() { return isClusteShading; }
 	void SetClusteShading(bool _isClusteShading) { isClusteShading = _isClusteShading; }
 
+	/// the ispc backend is only there when the build compiles Source/Ispc, CLUSTE_USE_ISPC
+#ifdef CLUSTE_USE_ISPC
+	static bool IsISPCAvailable() { return true; }
+#else
+	static bool IsISPCAvailable() { return false; }
+#endif
 	bool IsISPC() { return isIspc; }
-	void SetISPC(bool _isIspc) { isIspc = _isIspc; }
+	void SetISPC(bool _isIspc) { isIspc = _isIspc && IsISPCAvailable(); }
+
+	/// intrinsics backend for the cluste-major index lists, level is clamped to what the cpu supports
+	bool IsSimdCull() { return isSimdCull; }
+	void SetSimdCull(bool _isSimdCull) { isSimdCull = _isSimdCull; }
+	SimdCpu::SimdLevel GetSimdLevel() { return simdLevel; }
+	void SetSimdLevel(SimdCpu::SimdLevel _simdLevel) { simdLevel = _simdLevel < SimdCpu::GetSupportedLevel() ? _simdLevel : SimdCpu::GetSupportedLevel(); }
+
+	/// lights are also tested against the side planes of the cluste's tile, every backend but z-binning
+	bool IsExactCull() { return isExactCull; }
+	void SetExactCull(bool _isExactCull) { isExactCull = _isExactCull; }
+
+	/// light list entries of the last culled frame, the gpu count lags one frame.
+	/// the aabb/exact totals are the last frame culled each way, to measure what the exact test saves
+	glm::uint GetLightListEntries() { return light_list_entries; }
+	glm::uint GetAabbListEntries() { return aabb_list_entries; }
+	glm::uint GetExactListEntries() { return exact_list_entries; }
+	/// clustes whose list was clamped to MAX_LIGHTS_PER_CLUSTE in the last culled frame, the gpu count lags one frame.
+	/// the compute kernel counts them itself, cpu culling rescans the full lists only while the overflow check is on
+	glm::uint GetLightListOverflows() { return light_list_overflows; }
+	bool IsOverflowCheck() { return isOverflowCheck; }
+	void SetOverflowCheck(bool _isOverflowCheck) { isOverflowCheck = _isOverflowCheck; }
 
 	bool IsCpuClusteCull() { return isCpuClusteCull; }
 	void SetCpuClusteCull(bool _isCpuClusteCull) { isCpuClusteCull = _isCpuClusteCull; }
 
+	bool IsMultiThreadCull() { return isMultiThreadCull; }
+	void SetMultiThreadCull(bool _isMultiThreadCull) { isMultiThreadCull = _isMultiThreadCull; }
+
+	CpuCullMethod GetCpuCullMethod() { return cpuCullMethod; }
+	void SetCpuCullMethod(CpuCullMethod _cpuCullMethod) { cpuCullMethod = _cpuCullMethod; }
+
+	ClusteListFormat GetClusteListFormat() { return clusteListFormat; }
+	void SetClusteListFormat(ClusteListFormat _clusteListFormat) { clusteListFormat = _clusteListFormat; }
+
+	/// cpu culled lists are copied into the device local buffers before shading, as far as they were written
+	bool IsUploadLists() { return isUploadLists; }
+	void SetUploadLists(bool _isUploadLists) { isUploadLists = _isUploadLists; }
+
+	/// cpu index lists, indexes or compact, store each distinct light list once and let clustes share it.
+	/// the ratio is culled entries over stored entries of the last culled frame, 1 when not deduplicated
+	bool IsDedupLists() { return isDedupLists; }
+	void SetDedupLists(bool _isDedupLists) { isDedupLists = _isDedupLists; }
+	float GetListDedupRatio() { return list_dedup_ratio; }
+
+	/// culling is skipped while the camera and the lights stay the same, and only redone
+	/// around the changed lights when a few of them changed
+	bool IsTemporalReuse() { return isTemporalReuse; }
+	void SetTemporalReuse(bool _isTemporalReuse) { isTemporalReuse = _isTemporalReuse; }
+	ClusteCullReuse GetCullReuse() { return cullReuse; }
+
+	/// CpuCull_Amortized refreshes one of sliceGroups interleaved sets of z slices per frame
+	unsigned int GetAmortizedSliceGroups() { return amortizedSliceGroups; }
+	void SetAmortizedSliceGroups(unsigned int _amortizedSliceGroups) { amortizedSliceGroups = _amortizedSliceGroups > 0 ? _amortizedSliceGroups : 1; }
+
+	/// cpu culling runs on its own thread while the frame is recorded and is joined before the submit
+	bool IsAsyncCull() { return isAsyncCull; }
+	void SetAsyncCull(bool _isAsyncCull) { isAsyncCull = _isAsyncCull; }
+	double GetCullWaitTime() { return cullWaitTime; }	/// ms the submit waited on the async culling
+
 	double GetCpuCullTime() { return cpuCullTime; }
 
+	/// frames the cpu may record ahead of the gpu, 1 to MAX_FRAMES_IN_FLIGHT
+	unsigned int GetFramesInFlight() { return framesInFlight; }
+	void SetFramesInFlight(unsigned int _framesInFlight) { framesInFlight = std::max(1u, std::min(_framesInFlight, (unsigned int)MAX_FRAMES_IN_FLIGHT)); }
+
+	const std::vector<double>& GetIspcTaskTimes();	/// per task ms of the last ispc task culling, empty otherwise
+
+	/// the x/y tile counts follow from the tile size and the screen size, every cluste sized buffer is recreated
+	void SetClusteGrid(unsigned int tileSize, unsigned int zSlices);
+	glm::uvec3 GetClusteGrid() { return group_num; }
+	unsigned int GetClusteTileSize() { return tile_size_x; }
+
 private:
 	std::array<VkVertexInputBindingDescription, 1> GetBindingDescription();
 	std::array<VkVertexInputAttributeDescription, 6> GetAttributeDescriptions();
@@ -239,6 +385,23 @@ private:
 	void CreateSemaphores();
 
 	void SetScreenToViewData(ScreenToView* stv);
+	void UpdateClusteGridSize(unsigned int tileSize, unsigned int zSlices);
+	void UpdateLightListEntries(glm::uint entries);
+	void GetCullState(ClusteCullState* state);
+	ClusteCullReuse CheckCullReuse(bool canUpdate);
+	void SelectLightListSlot(int slot);
+	void SelectFrame(uint32_t frame);
+	void WaitCompute(uint64_t value);
+	void PollComputeCounts();
+	void CullCpu(bool isBitmask, bool isZBinning, bool isAmortized, bool isCompact, bool isDedup, int changedBegin, int changedEnd, int carrySlot);
+	void JoinCull();
+	void RecordListUpload(VkCommandBuffer commandBuffer);
+	void CullAmortized(bool isBitmask, glm::vec4* tilePlanes, LightGrid* lightGrids, glm::uint* lightIndexes);
+	void UpdateClusteAABBs();
+	void UpdateViewLights();
+	void UploadLights();
+	void CreateLightBuffers();
+	void ReleaseLightBuffers();
 
 	void CleanUp();
 
@@ -263,10 +426,15 @@ private:
 	std::vector<VkFramebuffer> swap_chain_framebuffers;
 	VkCommandPool command_pool;
 	std::vector<VkCommandBuffer> command_buffers;
-	VkSemaphore image_available_semaphore;
-	VkSemaphore render_finished_semaphore;
-	VkSemaphore compute_finished_semaphore;
-	VkFence in_flight_fence;
+	std::vector<VkCommandBuffer> upload_command_buffers;
+	/// per frame in flight sync, frame_index picks the set the recorded frame uses
+	VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
+	VkSemaphore render_finished_semaphores[MAX_FRAMES_IN_FLIGHT];
+	VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
+	std::vector<VkFence> images_in_flight;	/// fence of the frame that last drew each swap chain image
+	unsigned int framesInFlight;
+	uint32_t frame_index;
+	uint32_t last_frame_index;
 	VkImage depth_image;
 	VkDeviceMemory depth_image_memory;
 	VkImageView depth_image_view;
@@ -279,32 +447,44 @@ private:
 	VkDescriptorImageInfo* normal_image_info;
 	Texture* default_tex;
 
-	std::vector<PointLightData> light_infos;
+	LightStore* light_store;
 	
-	/// uniform buffers
-	VkBuffer transform_uniform_buffer;
-	VkDeviceMemory transform_uniform_buffer_memory;
-	VkDescriptorBufferInfo transform_uniform_buffer_info;
-	void* transform_uniform_buffer_data;
-
-	std::vector<VkBuffer> light_uniform_buffers;
-	std::vector<VkDeviceMemory> light_uniform_buffer_memorys;
-	std::vector<VkDescriptorBufferInfo> light_uniform_buffer_infos;
-	std::vector<void*> light_uniform_buffer_datas;
+	/// uniform buffers, one transform block per frame in flight, carried over when the frame changes
+	VkBuffer transform_uniform_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory transform_uniform_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorBufferInfo transform_uniform_buffer_info[MAX_FRAMES_IN_FLIGHT];
+	void* transform_uniform_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* transform_uniform_buffer_data;	/// the block of frame_index
+
+	/// light datas for shading, sized by light_capacity
+	unsigned int light_capacity;
+	unsigned int light_index_capacity;	/// per cluste, min(light_capacity, MAX_LIGHTS_PER_CLUSTE)
+	unsigned int light_mask_words;	/// per cluste bitmask, the local index buffer is big enough for either
+	/// one copy per frame in flight, each catches up on the slots changed since it was written last
+	VkBuffer light_datas_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory light_datas_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* light_datas_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* light_datas_buffer_data;	/// the copy of frame_index
+	VkDescriptorBufferInfo light_datas_buffer_info[MAX_FRAMES_IN_FLIGHT];
+	int light_datas_dirty_begin[MAX_FRAMES_IN_FLIGHT];
+	int light_datas_dirty_end[MAX_FRAMES_IN_FLIGHT];
 
 	/// cluste calculate
 	unsigned int tile_size_x;	/// ss width height
 	glm::uvec3 group_num;
+	unsigned int cluste_num;
 	VkDescriptorPool comp_desc_pool;
 	VkDescriptorSetLayout comp_desc_layout;
 	VkPipelineLayout comp_pipeline_layout;
-	VkPipeline comp_pipelines[2];
+	VkPipeline comp_pipeline;
 	VkDescriptorSet comp_desc_set[3];
-	VkCommandBuffer comp_command_buffers[2*3];
+	VkCommandBuffer comp_command_buffers[3];
 	VkQueue comp_queue;
 	VkCommandPool comp_command_pool;
-	VkFence comp_wait_fence;
-	VkShaderModule comp_cluste_shader_module;
+	/// dispatch n signals n, the graphics submit waits for the value of its frame's dispatch
+	VkSemaphore comp_timeline_semaphore;
+	uint64_t comp_timeline_value;	/// of the last dispatch submitted
+	uint64_t comp_counts_value;	/// the dispatch the list totals were last read from
 	VkShaderModule cluste_cull_shader_module;
 
 	/// tile aabb
@@ -312,48 +492,120 @@ private:
 	VkDeviceMemory tile_aabbs_buffer_memory;
 	void* tile_aabbs_buffer_data;
 	VkDescriptorBufferInfo tile_aabbs_buffer_info;
-
-	/// screen to view
-	VkBuffer screen_to_view_buffer;
-	VkDeviceMemory screen_to_view_buffer_memory;
-	void* screen_to_view_buffer_data;
-	VkDescriptorBufferInfo screen_to_view_buffer_info;
-
-	/// light datas
-	VkBuffer light_datas_buffer;
-	VkDeviceMemory light_datas_buffer_memory;
-	void* light_datas_buffer_data;
-	VkDescriptorBufferInfo light_datas_buffer_info;
-
-	/// light indexes
-	VkBuffer local_light_indexes_buffer;
-	VkDeviceMemory local_light_indexes_buffer_memory;
-	VkBuffer gpu_light_indexes_buffer;
-	VkDeviceMemory gpu_light_indexes_buffer_memory;
-	void* light_indexes_buffer_data;
-	VkDescriptorBufferInfo local_light_indexes_buffer_info;
-	VkDescriptorBufferInfo gpu_light_indexes_buffer_info;
-
-	/// light grids
-	VkBuffer local_light_grids_buffer;
-	VkDeviceMemory local_light_grids_buffer_memory;
-	VkBuffer gpu_light_grids_buffer;
-	VkDeviceMemory gpu_light_grids_buffer_memory;
-	void* light_grids_buffer_data;
-	VkDescriptorBufferInfo local_light_grids_buffer_info;
-	VkDescriptorBufferInfo gpu_light_grids_buffer_info;
-
-	/// index count
-	VkBuffer index_count_buffer;
-	VkDeviceMemory index_count_buffer_memory;
-	void* index_count_buffer_data;
-	VkDescriptorBufferInfo index_count_buffer_info;
+	Camera* tile_aabbs_camera;	/// the aabbs are rebuilt when any of these changes
+	unsigned int tile_aabbs_project_version;
+	glm::uvec2 tile_aabbs_screen_size;
+	std::vector<glm::vec4> tile_planes;	/// z-binning, 4 side planes per screen tile, rebuilt with the aabbs
+
+	/// screen to view, same ring as the light lists
+	VkBuffer screen_to_view_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory screen_to_view_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* screen_to_view_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* screen_to_view_buffer_data;	/// the slot of light_list_slot
+	VkDescriptorBufferInfo screen_to_view_buffer_info[MAX_FRAMES_IN_FLIGHT];
+
+	/// view space lights, pos in xyz and radius in w, written once per frame for every culling backend.
+	/// a ring of their own, a dispatch may still read the copy before
+	VkBuffer light_views_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory light_views_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* light_views_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* light_views_buffer_data;	/// the copy of view_light_slot
+	VkDescriptorBufferInfo light_views_buffer_info[MAX_FRAMES_IN_FLIGHT];
+	int view_light_slot;
+	uint64_t view_light_values[MAX_FRAMES_IN_FLIGHT];	/// dispatch that read each copy last, 0 for none
+
+	/// light indexes, the cpu written ones are a ring with one slot per frame in flight
+	VkBuffer local_light_indexes_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory local_light_indexes_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	VkBuffer gpu_light_indexes_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory gpu_light_indexes_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* light_indexes_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* light_indexes_buffer_data;	/// the slot of light_list_slot
+	VkDescriptorBufferInfo local_light_indexes_buffer_info[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorBufferInfo gpu_light_indexes_buffer_info[MAX_FRAMES_IN_FLIGHT];
+
+	/// light grids, same ring as the light indexes
+	VkBuffer local_light_grids_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory local_light_grids_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	VkBuffer gpu_light_grids_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory gpu_light_grids_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* light_grids_slot_data[MAX_FRAMES_IN_FLIGHT];
+	void* light_grids_buffer_data;	/// the slot of light_list_slot
+	VkDescriptorBufferInfo local_light_grids_buffer_info[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorBufferInfo gpu_light_grids_buffer_info[MAX_FRAMES_IN_FLIGHT];
+
+	/// culling, cpu or gpu, writes a slot no frame in flight reads, a skipped cull keeps drawing from the last one.
+	/// the gpu buffers share the slot, uploads and dispatches write the one of the cpu lists
+	int light_list_slot;
+	uint64_t light_list_values[MAX_FRAMES_IN_FLIGHT];	/// dispatch that used each slot last, 0 for none
+	bool isUploadLists;
+	bool isListUploadPending;	/// the cpu culled this frame, its slot is copied to the gpu buffers at the submit
+	VkDeviceSize light_grids_dirty_bytes;	/// written by the last cpu cull
+	VkDeviceSize light_indexes_dirty_bytes;
+	int light_slots_to_clear;	/// slots ClearLightBufferData left to clear, each is cleared once it is written next
+
+	/// index count, same ring as the light lists
+	VkBuffer index_count_buffer[MAX_FRAMES_IN_FLIGHT];
+	VkDeviceMemory index_count_buffer_memory[MAX_FRAMES_IN_FLIGHT];
+	void* index_count_slot_data[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorBufferInfo index_count_buffer_info[MAX_FRAMES_IN_FLIGHT];
 
 	bool isClusteShading;
 	bool isIspc;
 	bool isCpuClusteCull;
+	bool isMultiThreadCull;
+	bool isSimdCull;
+	bool isExactCull;
+	bool isOverflowCheck;	/// debug only, costs a light scan per full cluste
+	bool isTemporalReuse;
+	bool isAsyncCull;
+	SimdCpu::SimdLevel simdLevel;
+	CpuCullMethod cpuCullMethod;
+	ClusteListFormat clusteListFormat;
+	bool isDedupLists;
+
+	/// workers for cpu cluste culling
+	ThreadPool* cull_thread_pool;
+	ThreadPool* cull_job_thread;	/// runs the async culling, apart from the pool the culling itself may spread over
+	std::future<void> cull_job;
+	LightBVH* light_bvh;	/// rebuilt from the view lights every frame
+	std::vector<glm::uint> ispc_task_lists;	/// per task lists of cluste_culling_tasks_ispc
+	std::vector<glm::uint> ispc_task_offsets;
+	std::vector<float> simd_light_storage;	/// view lights in struct of arrays for the simd culling
+	std::vector<LightGrid> cull_light_grids;	/// 32 bit lists the compact and deduplicated lists are built from
+	std::vector<glm::uint> cull_light_indexes;
+	std::vector<LightGrid> dedup_light_grids;	/// deduplicated lists the compact format is packed from
+	std::vector<glm::uint> dedup_light_indexes;
+	std::vector<glm::uint> dedup_table;
+
+	/// amortized culling
+	unsigned int amortizedSliceGroups;
+	int amortized_slice_group;	/// the slices culled next frame
+	int amortized_slice_groups;	/// slice groups of the stale lists
+	std::vector<glm::vec4> amortized_prev_lights;	/// view lights of the last amortized cull
+	std::vector<glm::vec4> amortized_view_lights;	/// inflated spheres
+	std::vector<float> amortized_light_motion;	/// largest per frame motion of every light
+
+	/// temporal reuse, the light lists stay valid while the state and the light version are those of the last cull
+	ClusteCullState cull_state;
+	bool is_cull_state_valid;	/// cleared whenever the cluste buffers are recreated or cleared
+	unsigned int cull_light_version;
+	int cull_light_count;
+	int changed_lights_begin;	/// light slots written since the last cull, collected by UploadLights
+	int changed_lights_end;
+	std::vector<glm::vec4> changed_view_lights;	/// spheres the changed slots were last culled with
+	std::vector<glm::uint> reuse_index_list;	/// scratch for the previous index lists
+	ClusteCullReuse cullReuse;
+	bool isCullSetupChanged;	/// grid, projection or culling mode differ from the last culled frame, the view may not
+	bool isCompDispatched;	/// the compute culling ran this frame, the graphics submit waits for it
 
 	double cpuCullTime;
+	double cullWaitTime;
+	glm::uint light_list_entries;
+	glm::uint aabb_list_entries;
+	glm::uint exact_list_entries;
+	glm::uint light_list_overflows;
+	float list_dedup_ratio;
 };
 
 
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "Application/Application.h"
+#include "Renderer/VRenderer.h"
+#include "Renderer/Camera.h"
+#include "ClusteTuner.h"
+
+/// candidate grids, every tile size is tried with every slice count
+static const unsigned int tuner_tile_sizes[] = { 32, 48, 64, 80, 96, 128 };
+static const unsigned int tuner_z_slices[] = { 16, 24, 32, 48 };
+static const int tuner_tile_size_num = sizeof(tuner_tile_sizes) / sizeof(tuner_tile_sizes[0]);
+static const int tuner_z_slice_num = sizeof(tuner_z_slices) / sizeof(tuner_z_slices[0]);
+
+ClusteTuner::ClusteTuner(Camera* cam, VulkanRenderer* renderer)
+{
+	camera = cam;
+	vRenderer = renderer;
+	state = Tuner_Idle;
+	origin_tile_size = 0;
+	origin_z_slices = 0;
+	candidate = 0;
+	frame = 0;
+	last_time = 0.0;
+	frame_ms = 0.0;
+	cull_ms = 0.0;
+}
+
+ClusteTuner::~ClusteTuner()
+{
+}
+
+void ClusteTuner::Toggle()
+{
+	if (state == Tuner_Idle)
+	{
+		path.clear();
+		state = Tuner_Recording;
+		printf("cluste tuner: recording camera path\n");
+	}
+	else if (state == Tuner_Recording)
+	{
+		StartSweep();
+	}
+	else
+	{
+		vRenderer->SetClusteGrid(origin_tile_size, origin_z_slices);
+		state = Tuner_Idle;
+		printf("cluste tuner: aborted\n");
+	}
+}
+
+void ClusteTuner::Update()
+{
+	if (state == Tuner_Recording)
+	{
+		CameraKey key;
+		key.pos = camera->GetPosition();
+		key.look_at = camera->GetLookAtPosition();
+		path.push_back(key);
+		return;
+	}
+
+	if (state != Tuner_Sweeping)
+	{
+		return;
+	}
+
+	/// this update closes the previous frame, whose cull time is still in the renderer
+	double nowTime = glfwGetTime();
+	int key = frame - TUNER_WARMUP_FRAMES;
+	if (key > 0)
+	{
+		frame_ms += (nowTime - last_time) * 1000.0;
+		cull_ms += vRenderer->GetCpuCullTime();
+	}
+	last_time = nowTime;
+
+	if (key == (int)path.size())
+	{
+		GridResult& result = results.back();
+		result.frame_ms = frame_ms / path.size();
+		result.cull_ms = cull_ms / path.size();
+		printf("cluste tuner: tile %3u z %2u grid %ux%ux%u frame %.3f ms cull %.3f ms\n", result.tile_size, result.z_slices,
+			result.grid.x, result.grid.y, result.grid.z, result.frame_ms, result.cull_ms);
+
+		candidate++;
+		if (candidate == tuner_tile_size_num * tuner_z_slice_num)
+		{
+			FinishSweep();
+			return;
+		}
+		StartCandidate();
+		key = frame - TUNER_WARMUP_FRAMES;
+	}
+
+	CameraKey& cameraKey = path[std::max(key, 0)];
+	camera->SetPosition(cameraKey.pos);
+	camera->LookAt(cameraKey.look_at);
+	frame++;
+}
+
+void ClusteTuner::StartSweep()
+{
+	if (path.empty())
+	{
+		state = Tuner_Idle;
+		printf("cluste tuner: empty camera path\n");
+		return;
+	}
+
+	origin_tile_size = vRenderer->GetClusteTileSize();
+	origin_z_slices = vRenderer->GetClusteGrid().z;
+	results.clear();
+	candidate = 0;
+	state = Tuner_Sweeping;
+	printf("cluste tuner: sweeping %d grids over %d frames\n", tuner_tile_size_num * tuner_z_slice_num, (int)path.size());
+	StartCandidate();
+}
+
+void ClusteTuner::StartCandidate()
+{
+	GridResult result;
+	result.tile_size = tuner_tile_sizes[candidate / tuner_z_slice_num];
+	result.z_slices = tuner_z_slices[candidate % tuner_z_slice_num];
+	vRenderer->SetClusteGrid(result.tile_size, result.z_slices);
+	result.grid = vRenderer->GetClusteGrid();
+	result.frame_ms = 0.0;
+	result.cull_ms = 0.0;
+	results.push_back(result);
+
+	frame = 0;
+	frame_ms = 0.0;
+	cull_ms = 0.0;
+}
+
+void ClusteTuner::FinishSweep()
+{
+	/// frame time covers culling and shading, whichever path is active
+	int best = 0;
+	for (int i = 1; i < results.size(); i++)
+	{
+		if (results[i].frame_ms < results[best].frame_ms)
+		{
+			best = i;
+		}
+	}
+
+	GridResult& result = results[best];
+	printf("cluste tuner: best tile %u z %u grid %ux%ux%u frame %.3f ms cull %.3f ms\n", result.tile_size, result.z_slices,
+		result.grid.x, result.grid.y, result.grid.z, result.frame_ms, result.cull_ms);
+
+	vRenderer->SetClusteGrid(result.tile_size, result.z_slices);
+	state = Tuner_Idle;
+}
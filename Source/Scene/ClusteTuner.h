@@ -0,0 +1,77 @@
+#ifndef __CLUSTE_TUNER_H__
+#define	__CLUSTE_TUNER_H__
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#define TUNER_WARMUP_FRAMES 8	/// skipped after every grid switch, buffers were just recreated
+
+class Camera;
+class VulkanRenderer;
+
+/// records a camera path, then replays it once per candidate grid and reports
+/// the grid with the lowest frame time. the lights are whatever the scene has
+class ClusteTuner
+{
+	enum TunerState
+	{
+		Tuner_Idle,
+		Tuner_Recording,
+		Tuner_Sweeping,
+	};
+
+	struct CameraKey
+	{
+		glm::vec3 pos;
+		glm::vec3 look_at;
+	};
+
+	struct GridResult
+	{
+		unsigned int tile_size;
+		unsigned int z_slices;
+		glm::uvec3 grid;
+		double frame_ms;
+		double cull_ms;
+	};
+
+public:
+	ClusteTuner(Camera* cam, VulkanRenderer* renderer);
+	virtual ~ClusteTuner();
+
+	bool IsRecording() { return state == Tuner_Recording; }
+	bool IsSweeping() { return state == Tuner_Sweeping; }
+
+	/// idle -> recording -> sweeping, a toggle while sweeping aborts and restores the grid
+	void Toggle();
+
+	/// once per frame, records or replays the camera
+	void Update();
+
+private:
+	void StartSweep();
+	void StartCandidate();
+	void FinishSweep();
+
+private:
+	Camera* camera;
+	VulkanRenderer* vRenderer;
+	TunerState state;
+
+	std::vector<CameraKey> path;
+	std::vector<GridResult> results;
+
+	unsigned int origin_tile_size;
+	unsigned int origin_z_slices;
+
+	int candidate;
+	int frame;
+	double last_time;
+	double frame_ms;
+	double cull_ms;
+};
+
+#endif // !__CLUSTE_TUNER_H__
@@ -3,6 +3,7 @@
 #include "Renderer/TOModel.h"
 #include "Renderer/Camera.h"
 #include "Renderer/Light.h"
+#include "ClusteTuner.h"
 #include "SampleScene.h"
 
 SampleScene::SampleScene()
@@ -12,6 +13,7 @@ SampleScene::SampleScene()
 	model = NULL;
 	last_control_state = 0;
 	shadingMode = NoClusteShading;
+	tuner = NULL;
 }
 
 SampleScene::~SampleScene()
@@ -30,7 +32,8 @@ bool SampleScene::OnEnter()
 	///model->SetRotation(rotate);
 	//model->LoadTestData();
 	VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
-	for (int i = 0; i < MAX_LIGHT_NUM; i++)
+	vRenderer->ReserveLights(SAMPLE_LIGHT_NUM);
+	for (int i = 0; i < SAMPLE_LIGHT_NUM; i++)
 	{
 		int y = i % 2;
 		int left = i / 2;
@@ -50,6 +53,8 @@ bool SampleScene::OnEnter()
 		vRenderer->AddLight(light[i]);
 	}
 
+	tuner = new ClusteTuner(camera, vRenderer);
+
 	return true;
 }
 
@@ -59,7 +64,68 @@ bool SampleScene::OnUpdate(float dt)
 	if (colorR >= 1.0f)
 		colorR = 0.0f;
 
-	UpdateCameraByInput();
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_T)
+	{
+		tuner->Toggle();
+	}
+	if (!tuner->IsSweeping())
+		UpdateCameraByInput();
+	tuner->Update();
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_B)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		if (vRenderer->GetClusteListFormat() == ClusteList_Indexes)
+			vRenderer->SetClusteListFormat(ClusteList_Bitmask);
+		else if (vRenderer->GetClusteListFormat() == ClusteList_Bitmask)
+			vRenderer->SetClusteListFormat(ClusteList_Compact);
+		else
+			vRenderer->SetClusteListFormat(ClusteList_Indexes);
+		vRenderer->ClearLightBufferData();
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_D)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetDedupLists(!vRenderer->IsDedupLists());
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_A)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetAsyncCull(!vRenderer->IsAsyncCull());
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_U)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetUploadLists(!vRenderer->IsUploadLists());
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_F)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetFramesInFlight(vRenderer->GetFramesInFlight() % MAX_FRAMES_IN_FLIGHT + 1);
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_X)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetExactCull(!vRenderer->IsExactCull());
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_O)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetOverflowCheck(!vRenderer->IsOverflowCheck());
+	}
+
+	if (Application::Inst()->GetPressedKey() == GLFW_KEY_R)
+	{
+		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
+		vRenderer->SetTemporalReuse(!vRenderer->IsTemporalReuse());
+	}
+
 	if (Application::Inst()->GetPressedKey() == GLFW_KEY_C)
 	{
 		VulkanRenderer* vRenderer = (VulkanRenderer*)Application::Inst()->GetRenderer();
@@ -68,6 +134,8 @@ bool SampleScene::OnUpdate(float dt)
 			vRenderer->SetClusteShading(true);
 			vRenderer->SetCpuClusteCull(false);
 			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(false);
+			vRenderer->SetCpuCullMethod(CpuCull_ClusteMajor);
 			shadingMode = ClusteShading_Compute;
 		}
 		else if (shadingMode == ClusteShading_Compute)
@@ -81,10 +149,101 @@ bool SampleScene::OnUpdate(float dt)
 		{
 			vRenderer->SetClusteShading(true);
 			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(true);
+			shadingMode = ClusteShading_RawCpuMT;
+		}
+		else if (shadingMode == ClusteShading_RawCpuMT)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(false);
+			vRenderer->SetCpuCullMethod(CpuCull_LightMajor);
+			shadingMode = ClusteShading_RawCpuLightMajor;
+		}
+		else if (shadingMode == ClusteShading_RawCpuLightMajor)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(false);
+			vRenderer->SetCpuCullMethod(CpuCull_ZBinning);
+			shadingMode = ClusteShading_RawCpuZBinning;
+		}
+		else if (shadingMode == ClusteShading_RawCpuZBinning)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(true);
+			vRenderer->SetCpuCullMethod(CpuCull_LightBVH);
+			shadingMode = ClusteShading_RawCpuLightBVH;
+		}
+		else if (shadingMode == ClusteShading_RawCpuLightBVH)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(true);
+			vRenderer->SetCpuCullMethod(CpuCull_SuperCluste);
+			shadingMode = ClusteShading_RawCpuSuperCluste;
+		}
+		else if (shadingMode == ClusteShading_RawCpuSuperCluste)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetMultiThreadCull(true);
+			vRenderer->SetCpuCullMethod(CpuCull_Amortized);
+			shadingMode = ClusteShading_RawCpuAmortized;
+		}
+		else if (shadingMode == ClusteShading_RawCpuAmortized)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetSimdCull(true);
+			vRenderer->SetMultiThreadCull(false);
+			vRenderer->SetCpuCullMethod(CpuCull_ClusteMajor);
+			shadingMode = ClusteShading_Simd;
+		}
+		else if (shadingMode == ClusteShading_Simd)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(false);
+			vRenderer->SetSimdCull(true);
+			vRenderer->SetMultiThreadCull(true);
+			shadingMode = ClusteShading_SimdMT;
+		}
+		else if (shadingMode == ClusteShading_SimdMT && !VulkanRenderer::IsISPCAvailable())
+		{
+			/// builds without the ispc backend skip its modes
+			vRenderer->SetClusteShading(false);
+			vRenderer->SetCpuClusteCull(false);
+			vRenderer->SetSimdCull(false);
+			shadingMode = NoClusteShading;
+		}
+		else if (shadingMode == ClusteShading_SimdMT)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetSimdCull(false);
 			vRenderer->SetISPC(true);
+			vRenderer->SetMultiThreadCull(false);
+			vRenderer->SetCpuCullMethod(CpuCull_ClusteMajor);
 			shadingMode = ClusteShading_ISPC;
 		}
 		else if (shadingMode == ClusteShading_ISPC)
+		{
+			vRenderer->SetClusteShading(true);
+			vRenderer->SetCpuClusteCull(true);
+			vRenderer->SetISPC(true);
+			vRenderer->SetMultiThreadCull(true);
+			shadingMode = ClusteShading_ISPCTasks;
+		}
+		else if (shadingMode == ClusteShading_ISPCTasks)
 		{
 			vRenderer->SetClusteShading(false);
 			vRenderer->SetCpuClusteCull(false);
@@ -161,7 +320,13 @@ void SampleScene::OnExit()
 		delete model;
 	}
 
-	for (int i = 0; i < MAX_LIGHT_NUM; i++)
+	if (tuner != NULL)
+	{
+		delete tuner;
+		tuner = NULL;
+	}
+
+	for (int i = 0; i < SAMPLE_LIGHT_NUM; i++)
 	{
 		if (light[i] != NULL)
 			delete light[i];
@@ -3,9 +3,12 @@
 
 #include "Scene.h"
 
+#define SAMPLE_LIGHT_NUM 16	/// the renderer grows its light buffers, any count works
+
 class Camera;
 class TOModel;
 class PointLight;
+class ClusteTuner;
 class SampleScene : public Scene
 {
 	enum ShadingMode
@@ -13,7 +16,16 @@ class SampleScene : public Scene
 		NoClusteShading,
 		ClusteShading_Compute,
 		ClusteShading_RawCpu,
+		ClusteShading_RawCpuMT,
+		ClusteShading_RawCpuLightMajor,
+		ClusteShading_RawCpuZBinning,
+		ClusteShading_RawCpuLightBVH,
+		ClusteShading_RawCpuSuperCluste,
+		ClusteShading_RawCpuAmortized,
+		ClusteShading_Simd,
+		ClusteShading_SimdMT,
 		ClusteShading_ISPC,
+		ClusteShading_ISPCTasks,
 	};
 public:
 	SampleScene();
@@ -35,9 +47,11 @@ private:
 	TOModel* model;
 	int last_control_state;
 
-	PointLight* light[MAX_LIGHT_NUM];
+	PointLight* light[SAMPLE_LIGHT_NUM];
 
 	ShadingMode shadingMode;
+
+	ClusteTuner* tuner;	/// T: record a camera path, T again: sweep cluste grids over it
 };
 
 #endif // !__SAMPLE_SCENE_H__
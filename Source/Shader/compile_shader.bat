@@ -1,7 +1,6 @@
-C:\VulkanSDK\1.2.131.2\Bin\glslc sample.vert -o ../../Data/shader/sample_vert.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc sample.frag -o ../../Data/shader/sample_frag.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc tinyobj.vert -o ../../Data/shader/tinyobj_vert.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc tinyobj.frag -o ../../Data/shader/tinyobj_frag.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc cluste_calc.comp -o ../../Data/shader/cluste_calc.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc cluste_culling.comp -o ../../Data/shader/cluste_culling.spv
+"%VULKAN_SDK%\Bin\glslc" sample.vert -o ../../Data/shader/sample_vert.spv
+"%VULKAN_SDK%\Bin\glslc" sample.frag -o ../../Data/shader/sample_frag.spv
+"%VULKAN_SDK%\Bin\glslc" tinyobj.vert -o ../../Data/shader/tinyobj_vert.spv
+"%VULKAN_SDK%\Bin\glslc" tinyobj.frag -o ../../Data/shader/tinyobj_frag.spv
+"%VULKAN_SDK%\Bin\glslc" cluste_culling.comp -o ../../Data/shader/cluste_culling.spv
 pause
\ No newline at end of file
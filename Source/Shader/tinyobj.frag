@@ -1,6 +1,5 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-#define MAX_LIGHT_NUM 16
 
 struct LightGrid{
     uint offset;
@@ -20,6 +19,10 @@ layout (std140, binding = 0) uniform TransformData {
     float zFar;
     float scale;
     float bias;
+    uint lightCount;
+    uint lightMaskWords;
+    uint isZBinning;
+    uint isCompactList;
 } transform;
 
 layout(std140, binding = 1) uniform MaterialData
@@ -28,7 +31,7 @@ layout(std140, binding = 1) uniform MaterialData
     int has_normal_map;
 } material;
 
-layout(std140, binding = 2) uniform PointLightData
+struct PointLight
 {
     vec3 pos;
 	float radius;
@@ -41,7 +44,11 @@ layout(std140, binding = 2) uniform PointLightData
 	float attenuation_linear;
 	float attenuation_exp;
     vec2 padding;
-} pointLight[MAX_LIGHT_NUM];
+};
+
+layout (std430, binding = 2) readonly buffer lightSSBO{
+    PointLight pointLight[];
+};
 
 layout (std430, binding = 3) readonly buffer lightIndexSSBO{
     uint globalLightIndexList[];
@@ -58,7 +65,7 @@ layout(location = 1) in vec3 fragTexCoord;
 layout(location = 2) in vec3 fragPos;
 layout(location = 3) in vec3 tanViewPos;
 layout(location = 4) in vec3 tanFragPos;
-layout(location = 5) in vec3 tanLightPos[16];
+layout(location = 5) in mat3 tanTBN;
 
 layout(location = 0) out vec4 outColor;
 
@@ -84,6 +91,70 @@ void main() {
         ///outColor.xyz = vec3(color, color, color);
         ///return;
 
+        if(transform.isZBinning > 0)
+        {
+            // z-binning: lightGrid holds the first/last depth sorted light of every z bin,
+            // the list buffer holds the tile masks over sorted lights followed by the sorted light map
+            uint zBin = min(zTile, transform.tileSizes.z - 1);
+            uvec2 bin = uvec2(lightGrid[zBin].offset, lightGrid[zBin].count);
+            if(bin.x > bin.y)
+                return;
+            uint tileMaskOffset = (tiles.x + transform.tileSizes.x * tiles.y) * transform.lightMaskWords;
+            uint sortedOffset = transform.tileSizes.x * transform.tileSizes.y * transform.lightMaskWords;
+            for(uint word = bin.x / 32; word <= bin.y / 32; word++)
+            {
+                // keep the bits inside the bin range
+                uint lo = word == bin.x / 32 ? bin.x % 32 : 0;
+                uint hi = word == bin.y / 32 ? bin.y % 32 : 31;
+                uint bits = globalLightIndexList[tileMaskOffset + word] & (0xffffffffu << lo) & (0xffffffffu >> (31 - hi));
+                while(bits != 0)
+                {
+                    uint slot = word * 32 + uint(findLSB(bits));
+                    bits &= bits - 1;
+
+                    // final color
+                    outColor.xyz += lightingColor(globalLightIndexList[sortedOffset + slot]);
+                }
+            }
+            return;
+        }
+
+        if(transform.lightMaskWords > 0)
+        {
+            // bitmask lists: one bit per light, lightMaskWords words per cluste
+            uint maskOffset = tileIndex * transform.lightMaskWords;
+            for(uint word = 0; word < transform.lightMaskWords; word++)
+            {
+                uint bits = globalLightIndexList[maskOffset + word];
+                while(bits != 0)
+                {
+                    uint i = word * 32 + uint(findLSB(bits));
+                    bits &= bits - 1;
+
+                    // final color
+                    outColor.xyz += lightingColor(i);
+                }
+            }
+            return;
+        }
+
+        if(transform.isCompactList > 0)
+        {
+            // compact lists: one word per light grid, offset << 8 | count, two 16 bit light indexes per word
+            uint packedGrid = (tileIndex & 1) == 0 ? lightGrid[tileIndex / 2].offset : lightGrid[tileIndex / 2].count;
+            uint compactOffset = packedGrid >> 8;
+            uint compactCount = packedGrid & 0xffu;
+            for(uint idx = 0; idx < compactCount; idx++)
+            {
+                uint entry = compactOffset + idx;
+                uint i = (globalLightIndexList[entry / 2] >> ((entry & 1) * 16)) & 0xffffu;
+
+                // final color
+                outColor.xyz += lightingColor(i);
+            }
+            return;
+        }
+
         uint offset = lightGrid[tileIndex].offset;
         uint visibleLightCount = lightGrid[tileIndex].count;
         for(int idx = 0; idx < visibleLightCount; idx++)
@@ -96,8 +167,10 @@ void main() {
     }
     else
     {
-        for(int i = 0; i < MAX_LIGHT_NUM; i++)
+        for(uint i = 0; i < transform.lightCount; i++)
         {
+            if(pointLight[i].enabled == 0)
+                continue;
             // final color
             outColor.xyz += lightingColor(i);
         }
@@ -130,7 +203,7 @@ vec3 lightingColor(uint i)
         normal = vec3(0, 0, 1);
     }
     // diffuse
-    vec3 lightDir = normalize(tanLightPos[i] - tanFragPos);
+    vec3 lightDir = normalize(tanTBN * pointLight[i].pos - tanFragPos);
     float lambertian = max(dot(lightDir, normal), 0.0);
     vec3 diffuse = pointLight[i].diffuse_intensity * albedo * lambertian * pointLight[i].color;
     // specular
@@ -1,6 +1,5 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-#define MAX_LIGHT_NUM 16
 layout (std140, binding = 0) uniform TransformData {
     mat4 mvp;
     mat4 model;
@@ -14,6 +13,9 @@ layout (std140, binding = 0) uniform TransformData {
     float zFar;
     float scale;
     float bias;
+    uint lightCount;
+    uint lightMaskWords;
+    uint isZBinning;
 } transform;
 
 layout(std140, binding = 1) uniform MaterialData
@@ -22,21 +24,6 @@ layout(std140, binding = 1) uniform MaterialData
     int has_normal_map;
 } material;
 
-layout(std140, binding = 2) uniform PointLightData
-{
-    vec3 pos;
-	float radius;
-	vec3 color;
-    uint enabled;
-    float ambient_intensity;
-	float diffuse_intensity;
-	float specular_intensity;
-    float attenuation_constant;
-	float attenuation_linear;
-	float attenuation_exp;
-    vec2 padding;
-} pointLight[MAX_LIGHT_NUM];
-
 layout(location = 0) in vec4 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inTexcoord;
@@ -49,7 +36,7 @@ layout(location = 1) out vec3 fragTexCoord;
 layout(location = 2) out vec3 fragPos;
 layout(location = 3) out vec3 tanViewPos;
 layout(location = 4) out vec3 tanFragPos;
-layout(location = 5) out vec3 tanLightPos[16];
+layout(location = 5) out mat3 tanTBN;
 
 void main() {
     gl_Position = transform.mvp * inPosition;
@@ -64,8 +51,7 @@ void main() {
     vec3 B = cross(N, T);
     mat3 TBN = mat3(T, B, N);
     TBN = transpose(TBN);
-    for(int i = 0; i < MAX_LIGHT_NUM; i++)
-        tanLightPos[i] = TBN * pointLight[i].pos;
+    tanTBN = TBN;
     tanViewPos  = TBN * transform.cam_pos;
     tanFragPos  = TBN * fragPos;
 }
\ No newline at end of file